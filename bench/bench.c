@@ -0,0 +1,213 @@
+// fork, wait4 and rlimits are POSIX, hidden by -std=c99
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Benchmark harness for Lispy programs
+Runs the interpreter on each program RUNS times and reports median and
+minimum wall time, lval allocations and peak RSS as JSON on stdout,
+with a readable table on stderr */
+
+typedef struct
+{
+    char *name;
+    int status;
+    double median;
+    double min;
+    unsigned long allocs;
+    long peak_rss;
+} result;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Run INTERP on FILE once, stdout discarded
+When STATS is set, --mem-stats is passed and its total allocations parsed
+Returns the wait status, filling wall time and peak RSS in kilobytes */
+static int run_once(char *interp, char *file, int stats, double *wall,
+                    long *rss, unsigned long *allocs)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+
+    double start = now();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // Recursive programs need more than the default stack
+        struct rlimit rl;
+        getrlimit(RLIMIT_STACK, &rl);
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_STACK, &rl);
+
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(stats ? fds[1] : null, STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+
+        if (stats)
+            execl(interp, interp, "--mem-stats", file, (char *)NULL);
+        else
+            execl(interp, interp, file, (char *)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    // Sum the allocs column of the per-type table
+    FILE *err = fdopen(fds[0], "r");
+    char line[512];
+    int in_table = 0;
+    *allocs = 0;
+    while (fgets(line, sizeof(line), err))
+    {
+        unsigned long n;
+        if (strncmp(line, "type ", 5) == 0)
+            in_table = 1;
+        else if (line[0] == '\n')
+            in_table = 0;
+        else if (in_table && sscanf(line, "%*s %lu", &n) == 1)
+            *allocs += n;
+    }
+    fclose(err);
+
+    int status;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    *wall = now() - start;
+    *rss = ru.ru_maxrss;
+
+    return status;
+}
+
+// Write S to stdout as a JSON string, quotes included
+static void print_json_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+static void usage(char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-r runs] [-i interpreter] [-l label] program.lspy ...\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 5;
+    char *interp = "bin/parsing";
+    char *label = "";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:i:l:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'i':
+            interp = optarg;
+            break;
+        case 'l':
+            label = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind >= argc || runs <= 0)
+        usage(argv[0]);
+
+    int count = argc - optind;
+    result *results = calloc(count, sizeof(result));
+    double *times = malloc(sizeof(double) * runs);
+
+    fprintf(stderr, "%-24s %10s %10s %12s %10s\n", "program", "median ms",
+            "min ms", "allocs", "rss kb");
+    for (size_t i = 0; i < count; i++)
+    {
+        result *r = &results[i];
+        r->name = argv[optind + i];
+
+        // Untimed accounting run, site tracking would skew timings
+        double wall;
+        long rss;
+        unsigned long allocs;
+        r->status = run_once(interp, r->name, 1, &wall, &rss, &r->allocs);
+        r->peak_rss = rss;
+
+        for (size_t j = 0; j < runs; j++)
+        {
+            int status = run_once(interp, r->name, 0, &times[j], &rss, &allocs);
+            if (status != 0)
+                r->status = status;
+            if (rss > r->peak_rss)
+                r->peak_rss = rss;
+        }
+
+        qsort(times, runs, sizeof(double), cmp_double);
+        r->min = times[0];
+        r->median = runs % 2 ? times[runs / 2]
+                             : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+
+        fprintf(stderr, "%-24s %10.2f %10.2f %12lu %10ld%s\n", r->name,
+                r->median * 1e3, r->min * 1e3, r->allocs, r->peak_rss,
+                r->status ? "  FAILED" : "");
+    }
+
+    printf("{\"label\":");
+    print_json_string(label);
+    printf(",\"runs\":%d,\"benchmarks\":[", runs);
+    for (size_t i = 0; i < count; i++)
+    {
+        result *r = &results[i];
+        printf("%s{\"name\":", i ? "," : "");
+        print_json_string(r->name);
+        printf(",\"status\":%d,\"median_ms\":%.3f,\"min_ms\":%.3f,"
+               "\"allocs\":%lu,\"peak_rss_kb\":%ld}",
+               r->status, r->median * 1e3, r->min * 1e3, r->allocs,
+               r->peak_rss);
+    }
+    printf("]}\n");
+
+    free(times);
+    free(results);
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+// fmemopen, mkstemp and clock_gettime are POSIX, hidden by -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "grammar.h"
+#include "lib.h"
+#include "mpc.h"
+
+/* Parser micro-benchmark
+Times mpc_parse, mpc_parse_contents and mpc_parse_pipe on synthetic Lispy
+sources of growing size and nesting depth, and the two doge grammars.
+Reports throughput in MB/s, AST nodes/s and allocations per parse */
+
+// Time spent on each case, repeated parses are averaged
+#define BENCH_SECONDS 0.2
+
+/* Allocation counter, fed by linking with
+-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc */
+static unsigned long allocs = 0;
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t m);
+void *__real_realloc(void *p, size_t n);
+
+void *__wrap_malloc(size_t n)
+{
+    allocs++;
+    return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t m)
+{
+    allocs++;
+    return __real_calloc(n, m);
+}
+
+void *__wrap_realloc(void *p, size_t n)
+{
+    allocs++;
+    return __real_realloc(p, n);
+}
+
+enum
+{
+    VIA_STRING,
+    VIA_CONTENTS,
+    VIA_PIPE,
+};
+
+static char *via_name[] = {"parse", "contents", "pipe"};
+
+// Input shared by every parse of the current case
+static char *src;
+static size_t src_len;
+static char src_path[] = "/tmp/lispy-parse-XXXXXX";
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Flat top-level forms until LEN bytes */
+static char *gen_flat(size_t len)
+{
+    lbuf *b = lbuf_new(NULL);
+    for (long i = 0; b->len < len; i++)
+        lbuf_printf(b, "(def {x%ld} (+ %ld 1 \"str %ld\" {a b -%ld.5}))\n", i,
+                    i, i, i);
+    char *s = lbuf_take(b);
+    lbuf_del(b);
+
+    return s;
+}
+
+/* Forms nested DEPTH deep, repeated up to about 64KB */
+static char *gen_nested(int depth)
+{
+    lbuf *b = lbuf_new(NULL);
+    while (b->len < 64 * 1024)
+    {
+        for (size_t i = 0; i < depth; i++)
+            lbuf_puts(b, i % 2 ? "{x " : "(+ 1 ");
+        for (size_t i = 0; i < depth; i++)
+            lbuf_putc(b, (depth - i - 1) % 2 ? '}' : ')');
+        lbuf_putc(b, '\n');
+    }
+    char *s = lbuf_take(b);
+    lbuf_del(b);
+
+    return s;
+}
+
+/* Long strings and indentation, about 64KB */
+static char *gen_strings(void)
+{
+    lbuf *b = lbuf_new(NULL);
+    for (long i = 0; b->len < 64 * 1024; i++)
+    {
+        lbuf_printf(b, "(def {s%ld}\n                                \"", i);
+        for (int j = 0; j < 8; j++)
+            lbuf_puts(b, "lorem ipsum dolor sit amet, \\\"consectetur\\\"\n");
+        lbuf_puts(b, "\")\n");
+    }
+    char *s = lbuf_take(b);
+    lbuf_del(b);
+
+    return s;
+}
+
+/* Doge phrases until LEN bytes */
+static char *gen_doge(size_t len)
+{
+    char *adjectives[] = {"wow", "many", "so", "such"};
+    char *nouns[] = {"lisp", "language", "book", "build", "c"};
+
+    lbuf *b = lbuf_new(NULL);
+    for (size_t i = 0; b->len < len; i++)
+        lbuf_printf(b, "%s %s ", adjectives[i % 4], nouns[i % 5]);
+    char *s = lbuf_take(b);
+    lbuf_del(b);
+
+    return s;
+}
+
+static void set_input(char *s)
+{
+    free(src);
+    src = s;
+    src_len = strlen(s);
+
+    // mpc_parse_contents reads from a real file
+    FILE *f = fopen(src_path, "w");
+    fwrite(src, 1, src_len, f);
+    fclose(f);
+}
+
+static int parse_once(mpc_parser_t *p, int via, mpc_result_t *r)
+{
+    if (via == VIA_CONTENTS)
+        return mpc_parse_contents(src_path, p, r);
+
+    if (via == VIA_PIPE)
+    {
+        FILE *f = fmemopen(src, src_len, "r");
+        int ok = mpc_parse_pipe("<pipe>", f, p, r);
+        fclose(f);
+        return ok;
+    }
+
+    return mpc_parse("<string>", src, p, r);
+}
+
+/* Time parsing the current input with P
+AST outputs are measured in nodes, others are released with free */
+static void run_case(char *name, mpc_parser_t *p, int via, int ast)
+{
+    long nodes = 0;
+    unsigned long parse_allocs = 0;
+    long reps = 0;
+    double elapsed = 0;
+
+    while (elapsed < BENCH_SECONDS)
+    {
+        mpc_result_t r;
+        unsigned long before = allocs;
+        double start = now();
+        int ok = parse_once(p, via, &r);
+        elapsed += now() - start;
+        parse_allocs = allocs - before;
+        reps++;
+
+        if (!ok)
+        {
+            printf("%-22s %-9s parse failed: ", name, via_name[via]);
+            mpc_err_print(r.error);
+            mpc_err_delete(r.error);
+            return;
+        }
+
+        if (ast)
+        {
+            // Leaves plus rule nodes
+            nodes = number_of_nodes(r.output) + number_of_branches(r.output);
+            mpc_ast_delete(r.output);
+        }
+        else
+            free(r.output);
+    }
+
+    // Outputs other than ASTs have no nodes to count
+    double per = elapsed / reps;
+    printf("%-22s %-9s %10zu %10.2f ", name, via_name[via], src_len,
+           src_len / per / 1e6);
+    if (ast)
+        printf("%12.0f", nodes / per);
+    else
+        printf("%12s", "n/a");
+    printf(" %12lu\n", parse_allocs);
+}
+
+int main(int argc, char **argv)
+{
+    int fd = mkstemp(src_path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    mpc_parser_t *Lispy = lispy_grammar_new(false);
+
+    printf("%-22s %-9s %10s %10s %12s %12s\n", "input", "via", "bytes",
+           "MB/s", "nodes/s", "allocs");
+
+    char name[64];
+    size_t sizes[] = {1 << 10, 16 << 10, 128 << 10};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        set_input(gen_flat(sizes[i]));
+        snprintf(name, sizeof(name), "lispy flat %zuK", sizes[i] >> 10);
+        for (int via = VIA_STRING; via <= VIA_PIPE; via++)
+            run_case(name, Lispy, via, 1);
+    }
+
+    // mpc gives up past MPC_MAX_RECURSION_DEPTH, about 110 Lispy levels
+    int depths[] = {4, 32, 96};
+    for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+    {
+        set_input(gen_nested(depths[i]));
+        snprintf(name, sizeof(name), "lispy depth %d", depths[i]);
+        for (int via = VIA_STRING; via <= VIA_PIPE; via++)
+            run_case(name, Lispy, via, 1);
+    }
+
+    set_input(gen_strings());
+    for (int via = VIA_STRING; via <= VIA_PIPE; via++)
+        run_case("lispy strings 64K", Lispy, via, 1);
+
+    // Same grammars as src/doge.c and src/doge_grammar.c
+    mpc_parser_t *Adjective = mpc_or(4, mpc_sym("wow"), mpc_sym("many"),
+                                     mpc_sym("so"), mpc_sym("such"));
+    mpc_parser_t *Noun =
+        mpc_or(5, mpc_sym("lisp"), mpc_sym("language"), mpc_sym("book"),
+               mpc_sym("build"), mpc_sym("c"));
+    mpc_parser_t *Phrase = mpc_and(2, mpcf_strfold, Adjective, Noun, free);
+    mpc_parser_t *Doge = mpc_many(mpcf_strfold, Phrase);
+
+    mpc_parser_t *GAdjective = mpc_new("adjective");
+    mpc_parser_t *GNoun = mpc_new("noun");
+    mpc_parser_t *GPhrase = mpc_new("phrase");
+    mpc_parser_t *GDoge = mpc_new("doge");
+    mpca_lang(MPCA_LANG_DEFAULT, "                \
+        adjective : \"wow\" | \"many\"            \
+                  |  \"so\" | \"such\";           \
+        noun      : \"lisp\" | \"language\"       \
+                  | \"book\" | \"build\" | \"c\"; \
+        phrase    : <adjective> <noun>;           \
+        doge      : <phrase>*;                    \
+    ",
+              GAdjective, GNoun, GPhrase, GDoge);
+
+    set_input(gen_doge(64 << 10));
+    run_case("doge 64K", Doge, VIA_STRING, 0);
+    run_case("doge_grammar 64K", GDoge, VIA_STRING, 1);
+
+    mpc_delete(Doge);
+    mpc_cleanup(4, GAdjective, GNoun, GPhrase, GDoge);
+    lispy_grammar_delete();
+    unlink(src_path);
+    free(src);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+// getline and clock_gettime are POSIX, hidden by -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+
+#include "batch.h"
+#include "memstats.h"
+
+static double batch_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Write S as a quoted JSON string */
+static void json_str(FILE *f, const char *s, size_t len)
+{
+    fputc('"', f);
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = s[i];
+        switch (c)
+        {
+        case '"':
+            fputs("\\\"", f);
+            break;
+        case '\\':
+            fputs("\\\\", f);
+            break;
+        case '\n':
+            fputs("\\n", f);
+            break;
+        case '\r':
+            fputs("\\r", f);
+            break;
+        case '\t':
+            fputs("\\t", f);
+            break;
+        default:
+            if (c < 0x20)
+                fprintf(f, "\\u%04x", c);
+            else
+                fputc(c, f);
+            break;
+        }
+    }
+    fputc('"', f);
+}
+
+/* Emit a single result line */
+static void batch_emit(const char *file, long line, int form,
+                       const char *result, size_t result_len,
+                       const char *output, size_t output_len, bool error,
+                       double wall, unsigned long allocs)
+{
+    printf("{\"file\":");
+    json_str(stdout, file, strlen(file));
+    printf(",\"line\":%ld,\"form\":%d,\"result\":", line, form);
+    json_str(stdout, result, result_len);
+    printf(",\"output\":");
+    json_str(stdout, output, output_len);
+    printf(",\"error\":%s,\"wall_us\":%.3f,\"allocs\":%lu}\n",
+           error ? "true" : "false", wall * 1e6, allocs);
+}
+
+/* Evaluate each form of FILE, returns the number of failures */
+static int batch_file(lenv *e, mpc_parser_t *parser, const char *file)
+{
+    mpc_result_t r;
+    if (!mpc_parse_contents(file, parser, &r))
+    {
+        char *err_msg = mpc_err_string(r.error);
+        batch_emit(file, r.error->state.row + 1, 0, err_msg, strlen(err_msg),
+                   "", 0, true, 0, 0);
+        mpc_err_delete(r.error);
+        free(err_msg);
+        return 1;
+    }
+
+    int failures = 0;
+    int form = 0;
+    mpc_ast_t *root = r.output;
+    for (size_t i = 0; i < root->children_num; i++)
+    {
+        mpc_ast_t *t = root->children[i];
+        if (lval_read_ignored(t))
+            continue;
+
+        // Everything printed while evaluating belongs to the form
+        lbuf *out = lbuf_new(NULL);
+        lbuf *prev = lval_get_output();
+        lval_set_output(out);
+
+        // Only evaluation is measured, reading is left out
+        lval *v = lval_read(t);
+        unsigned long allocs = mem_allocs();
+        double start = batch_now();
+        lval *x = lval_eval(e, v);
+        double wall = batch_now() - start;
+        allocs = mem_allocs() - allocs;
+
+        lval_set_output(prev);
+
+        // Render the value separately from its side effects
+        char *result = lval_to_str(e, x);
+
+        bool error = x->type == LVAL_ERR;
+        failures += error;
+        batch_emit(file, t->state.row + 1, form++, result, strlen(result),
+                   out->data, out->len, error, wall, allocs);
+
+        lval_del(x);
+        lbuf_del(out);
+        free(result);
+    }
+
+    mpc_ast_delete(r.output);
+    fflush(stdout);
+
+    return failures;
+}
+
+int run_batch(lenv *e, mpc_parser_t *parser, int argc, char **argv)
+{
+    int failures = 0;
+    for (size_t i = 0; i < argc; i++)
+        failures += batch_file(e, parser, argv[i]);
+
+    // Corpora too large for the command line come through stdin
+    if (argc == 0)
+    {
+        char *line = NULL;
+        size_t cap = 0;
+        ssize_t len;
+        while ((len = getline(&line, &cap, stdin)) > 0)
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] != '\0')
+                failures += batch_file(e, parser, line);
+        }
+        free(line);
+    }
+
+    return failures != 0;
+}
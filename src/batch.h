@@ -0,0 +1,14 @@
+#ifndef batch_h
+#define batch_h
+
+#include "eval.h"
+#include "mpc.h"
+
+/* Evaluate every top-level form of the ARGC files in ARGV with PARSER
+Reads one filename per line from stdin when no files are given
+Emits one JSON object per form on stdout (JSON Lines):
+  file, line, form, result, output, error, wall_us, allocs
+Returns non-zero if any form failed to parse or evaluate */
+int run_batch(lenv *e, mpc_parser_t *parser, int argc, char **argv);
+
+#endif
@@ -0,0 +1,540 @@
+#include "bignum.h"
+#include "memstats.h"
+
+static lbig *lbig_alloc(size_t len)
+{
+    lbig *a = malloc(sizeof(lbig) + sizeof(uint32_t) * len);
+    mem_shared(LVAL_NUM, sizeof(lbig) + sizeof(uint32_t) * len);
+    a->refs = 1;
+    a->sign = 1;
+    a->len = len;
+
+    return a;
+}
+
+// Drop leading zero limbs, zero is positive
+static lbig *lbig_trim(lbig *a)
+{
+    while (a->len && !a->limb[a->len - 1])
+        a->len--;
+    if (!a->len)
+        a->sign = 1;
+
+    return a;
+}
+
+lbig *lbig_ref(lbig *a)
+{
+    a->refs++;
+    return a;
+}
+
+void lbig_del(lbig *a)
+{
+    if (!a || --a->refs)
+        return;
+
+    free(a);
+}
+
+lbig *lbig_from_long(long x)
+{
+    // Unsigned to survive LONG_MIN
+    unsigned long u = x < 0 ? -(unsigned long)x : (unsigned long)x;
+    lbig *a = lbig_alloc(2);
+    a->sign = x < 0 ? -1 : 1;
+    a->limb[0] = (uint32_t)u;
+    a->limb[1] = (uint32_t)(u >> 32);
+
+    return lbig_trim(a);
+}
+
+lbig *lbig_from_double(double d)
+{
+    int exp;
+    frexp(d, &exp);
+    lbig *a = lbig_alloc(exp > 0 ? (exp + 31) / 32 : 0);
+    a->sign = d < 0 ? -1 : 1;
+
+    // Every step is exact, D has no more than 53 significant bits
+    d = fabs(d);
+    for (size_t i = a->len; i-- > 0;)
+    {
+        double unit = ldexp(1, 32 * i);
+        double q = floor(d / unit);
+        a->limb[i] = (uint32_t)q;
+        d -= q * unit;
+    }
+
+    return lbig_trim(a);
+}
+
+/* R = R * M + C over LEN limbs, returning the limb carried out */
+static uint32_t lbig_mul_small(uint32_t *r, size_t len, uint32_t m, uint32_t c)
+{
+    uint64_t t = c;
+    for (size_t i = 0; i < len; i++)
+    {
+        t += (uint64_t)r[i] * m;
+        r[i] = (uint32_t)t;
+        t >>= 32;
+    }
+
+    return (uint32_t)t;
+}
+
+/* R = R / D over LEN limbs, returning the remainder */
+static uint32_t lbig_div_small(uint32_t *r, size_t len, uint32_t d)
+{
+    uint64_t t = 0;
+    for (size_t i = len; i-- > 0;)
+    {
+        t = t << 32 | r[i];
+        r[i] = (uint32_t)(t / d);
+        t %= d;
+    }
+
+    return (uint32_t)t;
+}
+
+lbig *lbig_read(const char *s)
+{
+    int sign = *s == '-' ? -1 : 1;
+    if (*s == '-')
+        s++;
+
+    // Each chunk of digits adds at most a limb
+    size_t digits = strlen(s);
+    lbig *a = lbig_alloc(digits / LBIG_CHUNK_DIGITS + 1);
+    a->sign = sign;
+    a->len = 0;
+
+    // A shorter first chunk leaves the others whole
+    size_t n = digits % LBIG_CHUNK_DIGITS;
+    if (!n)
+        n = LBIG_CHUNK_DIGITS;
+    for (; *s; s += n, n = LBIG_CHUNK_DIGITS)
+    {
+        uint32_t chunk = 0, scale = 1;
+        for (size_t i = 0; i < n; i++)
+        {
+            chunk = chunk * 10 + (s[i] - '0');
+            scale *= 10;
+        }
+
+        uint32_t c = lbig_mul_small(a->limb, a->len, scale, chunk);
+        if (c)
+            a->limb[a->len++] = c;
+    }
+
+    return lbig_trim(a);
+}
+
+bool lbig_to_long(lbig *a, long *x)
+{
+    if (a->len > 2)
+        return false;
+
+    unsigned long u = 0;
+    for (size_t i = 0; i < a->len; i++)
+        u |= (unsigned long)a->limb[i] << (32 * i);
+
+    // LONG_MIN has one more unit of magnitude than LONG_MAX
+    if (u > (unsigned long)LONG_MAX + (a->sign < 0))
+        return false;
+
+    *x = a->sign < 0 ? (long)(0 - u) : (long)u;
+    return true;
+}
+
+double lbig_to_double(lbig *a)
+{
+    double d = 0;
+    for (size_t i = a->len; i-- > 0;)
+        d = d * 0x1p32 + a->limb[i];
+
+    return a->sign * d;
+}
+
+/* -------------------------------------- */
+/* ---------- Magnitude Helpers ---------- */
+/* -------------------------------------- */
+
+static int lbig_cmp_mag(const uint32_t *a, size_t an, const uint32_t *b,
+                        size_t bn)
+{
+    if (an != bn)
+        return an < bn ? -1 : 1;
+
+    for (size_t i = an; i-- > 0;)
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+
+    return 0;
+}
+
+/* R += A over RN limbs, A holding at most RN of them
+Returns the limb carried out of R */
+static uint32_t lbig_add_into(uint32_t *r, size_t rn, const uint32_t *a,
+                              size_t an)
+{
+    uint64_t c = 0;
+    size_t i = 0;
+    for (; i < an; i++)
+    {
+        c += (uint64_t)r[i] + a[i];
+        r[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    for (; c && i < rn; i++)
+    {
+        c += r[i];
+        r[i] = (uint32_t)c;
+        c >>= 32;
+    }
+
+    return (uint32_t)c;
+}
+
+/* R -= A over RN limbs, A holding at most RN of them and not above R */
+static void lbig_sub_into(uint32_t *r, size_t rn, const uint32_t *a, size_t an)
+{
+    uint32_t borrow = 0;
+    size_t i = 0;
+    for (; i < an; i++)
+    {
+        uint64_t d = (uint64_t)r[i] - a[i] - borrow;
+        r[i] = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+    for (; borrow && i < rn; i++)
+        borrow = r[i]-- == 0;
+}
+
+/* R = A * B over AN + BN limbs, limb by limb */
+static void lbig_mul_school(uint32_t *r, const uint32_t *a, size_t an,
+                            const uint32_t *b, size_t bn)
+{
+    memset(r, 0, sizeof(uint32_t) * (an + bn));
+
+    for (size_t j = 0; j < bn; j++)
+    {
+        uint64_t c = 0;
+        for (size_t i = 0; i < an; i++)
+        {
+            // Fits, (2^32 - 1)^2 + 2 * (2^32 - 1) is 2^64 - 1
+            c += (uint64_t)a[i] * b[j] + r[i + j];
+            r[i + j] = (uint32_t)c;
+            c >>= 32;
+        }
+        r[j + an] = (uint32_t)c;
+    }
+}
+
+/* R = A * B over AN + BN limbs
+Operands are split at half the longer one, M limbs: with A = A1 B^M + A0 and
+B = B1 B^M + B0 the middle term (A0 + A1)(B0 + B1) - A0 B0 - A1 B1 saves one
+of the four products. A shorter B that has no upper half is multiplied with
+each half of A instead */
+static void lbig_mul_mag(uint32_t *r, const uint32_t *a, size_t an,
+                         const uint32_t *b, size_t bn)
+{
+    if (an < bn)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+
+    if (bn < LBIG_KARATSUBA)
+    {
+        lbig_mul_school(r, a, an, b, bn);
+        return;
+    }
+
+    size_t m = (an + 1) / 2;
+    if (bn <= m)
+    {
+        uint32_t *hi = malloc(sizeof(uint32_t) * (an - m + bn));
+        lbig_mul_mag(r, a, m, b, bn);
+        lbig_mul_mag(hi, a + m, an - m, b, bn);
+        memset(r + m + bn, 0, sizeof(uint32_t) * (an - m));
+        lbig_add_into(r + m, an - m + bn, hi, an - m + bn);
+        free(hi);
+        return;
+    }
+
+    // Low product in the lower 2M limbs of R, high one above it
+    lbig_mul_mag(r, a, m, b, m);
+    lbig_mul_mag(r + 2 * m, a + m, an - m, b + m, bn - m);
+
+    uint32_t *sa = calloc(m + 1, sizeof(uint32_t));
+    uint32_t *sb = calloc(m + 1, sizeof(uint32_t));
+    uint32_t *mid = malloc(sizeof(uint32_t) * (2 * m + 2));
+    memcpy(sa, a, sizeof(uint32_t) * m);
+    memcpy(sb, b, sizeof(uint32_t) * m);
+    lbig_add_into(sa, m + 1, a + m, an - m);
+    lbig_add_into(sb, m + 1, b + m, bn - m);
+    lbig_mul_mag(mid, sa, m + 1, sb, m + 1);
+    lbig_sub_into(mid, 2 * m + 2, r, 2 * m);
+    lbig_sub_into(mid, 2 * m + 2, r + 2 * m, an + bn - 2 * m);
+
+    // The middle term fits what is left of R, its top limbs are zero
+    size_t rest = an + bn - m;
+    lbig_add_into(r + m, rest, mid, rest < 2 * m + 2 ? rest : 2 * m + 2);
+    free(sa);
+    free(sb);
+    free(mid);
+}
+
+/* Q = U / V and R = U % V, U of UN limbs and V of VN, from 2 to UN
+Long division of Knuth's Algorithm D, V shifted so its top bit is set to
+keep every guess of a quotient limb at most two above the right one. Q
+holds UN - VN + 1 limbs, R VN */
+static void lbig_divmod_mag(uint32_t *q, uint32_t *r, const uint32_t *u,
+                            size_t un, const uint32_t *v, size_t vn)
+{
+    int s = __builtin_clz(v[vn - 1]);
+    uint32_t *vs = malloc(sizeof(uint32_t) * vn);
+    uint32_t *us = malloc(sizeof(uint32_t) * (un + 1));
+
+    for (size_t i = vn - 1; i > 0; i--)
+        vs[i] = v[i] << s | (uint32_t)((uint64_t)v[i - 1] >> (32 - s));
+    vs[0] = v[0] << s;
+    us[un] = (uint32_t)((uint64_t)u[un - 1] >> (32 - s));
+    for (size_t i = un - 1; i > 0; i--)
+        us[i] = u[i] << s | (uint32_t)((uint64_t)u[i - 1] >> (32 - s));
+    us[0] = u[0] << s;
+
+    for (size_t j = un - vn + 1; j-- > 0;)
+    {
+        // Guess from the top two limbs, corrected by the next one
+        uint64_t top = (uint64_t)us[j + vn] << 32 | us[j + vn - 1];
+        uint64_t qhat = top / vs[vn - 1];
+        uint64_t rhat = top % vs[vn - 1];
+        while (qhat >> 32 ||
+               qhat * vs[vn - 2] > (rhat << 32 | us[j + vn - 2]))
+        {
+            qhat--;
+            rhat += vs[vn - 1];
+            if (rhat >> 32)
+                break;
+        }
+
+        // Subtract QHAT times V, adding V back if it went one too far
+        int64_t borrow = 0, t;
+        for (size_t i = 0; i < vn; i++)
+        {
+            uint64_t p = qhat * vs[i];
+            t = us[i + j] - borrow - (int64_t)(p & 0xFFFFFFFF);
+            us[i + j] = (uint32_t)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+        t = us[j + vn] - borrow;
+        us[j + vn] = (uint32_t)t;
+
+        q[j] = (uint32_t)qhat;
+        if (t < 0)
+        {
+            q[j]--;
+            us[j + vn] += lbig_add_into(us + j, vn, vs, vn);
+        }
+    }
+
+    for (size_t i = 0; i < vn; i++)
+        r[i] = us[i] >> s |
+               (uint32_t)((uint64_t)us[i + 1] << (32 - s) & 0xFFFFFFFF);
+    free(vs);
+    free(us);
+}
+
+/* ------------------------------------------ */
+/* ---------- Arithmetic Operations ---------- */
+/* ------------------------------------------ */
+
+int lbig_cmp(lbig *a, lbig *b)
+{
+    if (a->sign != b->sign)
+        return a->sign;
+
+    return a->sign * lbig_cmp_mag(a->limb, a->len, b->limb, b->len);
+}
+
+// A plus B with the sign of B taken as SIGN
+static lbig *lbig_add_signed(lbig *a, lbig *b, int sign)
+{
+    lbig *r;
+
+    if (b->len && a->sign != sign)
+    {
+        // Magnitudes subtract, the larger one gives the sign
+        sign = -sign;
+        if (lbig_cmp_mag(a->limb, a->len, b->limb, b->len) < 0)
+        {
+            lbig *t = a;
+            a = b;
+            b = t;
+            sign = -sign;
+        }
+        r = lbig_alloc(a->len);
+        memcpy(r->limb, a->limb, sizeof(uint32_t) * a->len);
+        lbig_sub_into(r->limb, r->len, b->limb, b->len);
+        r->sign = sign;
+
+        return lbig_trim(r);
+    }
+
+    // Same signs, or B is zero and A keeps its own
+    sign = b->len ? sign : a->sign;
+    if (a->len < b->len)
+    {
+        lbig *t = a;
+        a = b;
+        b = t;
+    }
+    r = lbig_alloc(a->len + 1);
+    memcpy(r->limb, a->limb, sizeof(uint32_t) * a->len);
+    r->limb[a->len] = 0;
+    lbig_add_into(r->limb, r->len, b->limb, b->len);
+    r->sign = sign;
+
+    return lbig_trim(r);
+}
+
+lbig *lbig_add(lbig *a, lbig *b)
+{
+    return lbig_add_signed(a, b, b->sign);
+}
+
+lbig *lbig_sub(lbig *a, lbig *b)
+{
+    return lbig_add_signed(a, b, -b->sign);
+}
+
+lbig *lbig_neg(lbig *a)
+{
+    lbig *r = lbig_alloc(a->len);
+    memcpy(r->limb, a->limb, sizeof(uint32_t) * a->len);
+    r->sign = -a->sign;
+
+    return lbig_trim(r);
+}
+
+lbig *lbig_mul(lbig *a, lbig *b)
+{
+    if (!a->len || !b->len)
+        return lbig_alloc(0);
+
+    lbig *r = lbig_alloc(a->len + b->len);
+    lbig_mul_mag(r->limb, a->limb, a->len, b->limb, b->len);
+    r->sign = a->sign * b->sign;
+
+    return lbig_trim(r);
+}
+
+lbig *lbig_div(lbig *a, lbig *b, lbig **rem)
+{
+    lbig *q, *r;
+
+    if (lbig_cmp_mag(a->limb, a->len, b->limb, b->len) < 0)
+    {
+        q = lbig_alloc(0);
+        r = lbig_ref(a);
+    }
+    else if (b->len == 1)
+    {
+        q = lbig_alloc(a->len);
+        memcpy(q->limb, a->limb, sizeof(uint32_t) * a->len);
+        r = lbig_alloc(1);
+        r->limb[0] = lbig_div_small(q->limb, q->len, b->limb[0]);
+    }
+    else
+    {
+        q = lbig_alloc(a->len - b->len + 1);
+        r = lbig_alloc(b->len);
+        lbig_divmod_mag(q->limb, r->limb, a->limb, a->len, b->limb, b->len);
+    }
+
+    q->sign = a->sign * b->sign;
+    if (r != a)
+        r->sign = a->sign;
+    lbig_trim(q);
+    lbig_trim(r);
+
+    if (rem)
+        *rem = r;
+    else
+        lbig_del(r);
+
+    return q;
+}
+
+lbig *lbig_pow(lbig *a, unsigned long n)
+{
+    lbig *r = lbig_from_long(1);
+    lbig *x = lbig_ref(a);
+
+    // Square and multiply, squaring only while bits are left
+    while (n)
+    {
+        lbig *t;
+        if (n & 1)
+        {
+            t = lbig_mul(r, x);
+            lbig_del(r);
+            r = t;
+        }
+        n >>= 1;
+        if (n)
+        {
+            t = lbig_mul(x, x);
+            lbig_del(x);
+            x = t;
+        }
+    }
+    lbig_del(x);
+
+    return r;
+}
+
+void lbig_write(lbuf *b, lbig *a)
+{
+    if (!a->len)
+    {
+        lbuf_putc(b, '0');
+        return;
+    }
+
+    /* Chunks of LBIG_CHUNK_DIGITS digits from the least significant, one
+    pass of division by LBIG_CHUNK over the limbs each */
+    size_t len = a->len;
+    uint32_t *t = malloc(sizeof(uint32_t) * len);
+    memcpy(t, a->limb, sizeof(uint32_t) * len);
+    // Fewer than ten decimal digits per limb
+    size_t cap = len * 10 + 2;
+    char *digits = malloc(cap);
+    size_t i = cap;
+
+    while (len)
+    {
+        uint32_t chunk = lbig_div_small(t, len, LBIG_CHUNK);
+        while (len && !t[len - 1])
+            len--;
+
+        // Chunks below the top one keep their leading zeros
+        for (int k = 0; k < LBIG_CHUNK_DIGITS && (len || chunk); k++)
+        {
+            digits[--i] = '0' + chunk % 10;
+            chunk /= 10;
+        }
+    }
+
+    if (a->sign < 0)
+        digits[--i] = '-';
+    lbuf_write(b, digits + i, cap - i);
+    free(digits);
+    free(t);
+}
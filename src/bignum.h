@@ -0,0 +1,72 @@
+#ifndef bignum_h
+#define bignum_h
+
+#include <limits.h>
+#include <stdint.h>
+
+#include "eval.h"
+
+// Limbs from which multiplication splits operands instead of going digit-wise
+#define LBIG_KARATSUBA 32
+
+// Largest power of ten in a limb and its digits, the printer's chunk
+#define LBIG_CHUNK 1000000000u
+#define LBIG_CHUNK_DIGITS 9
+
+/* Integer of any size, shared between Numbers by reference count
+Sign and magnitude, limbs in base 2^32 from the least significant. Never
+changed once built, operations return new ones. The top limb is never zero,
+zero has no limbs and a positive sign */
+struct lbig
+{
+    int refs;
+    // 1 or -1
+    int sign;
+    size_t len;
+    uint32_t limb[];
+};
+
+/* Integer equal to X */
+lbig *lbig_from_long(long x);
+
+/* Integer equal to D, which has to be whole and finite */
+lbig *lbig_from_double(double d);
+
+/* Integer from the decimal digits of S, after an optional '-' */
+lbig *lbig_read(const char *s);
+
+/* Share A with one more owner */
+lbig *lbig_ref(lbig *a);
+
+/* Drop a reference, the last one frees A
+Does nothing on NULL */
+void lbig_del(lbig *a);
+
+/* Store A in X if it fits a long, false otherwise */
+bool lbig_to_long(lbig *a, long *x);
+
+/* Nearest double to A, infinite past the largest one */
+double lbig_to_double(lbig *a);
+
+/* Negative, zero or positive as A is below, equal to or above B */
+int lbig_cmp(lbig *a, lbig *b);
+
+lbig *lbig_add(lbig *a, lbig *b);
+lbig *lbig_sub(lbig *a, lbig *b);
+lbig *lbig_neg(lbig *a);
+
+/* Product of A and B, Karatsuba from LBIG_KARATSUBA limbs on */
+lbig *lbig_mul(lbig *a, lbig *b);
+
+/* Quotient of A by B rounded towards zero, as C does for longs
+B must not be zero. The remainder, taking the sign of A, is stored in REM
+unless NULL */
+lbig *lbig_div(lbig *a, lbig *b, lbig **rem);
+
+/* A to the power N */
+lbig *lbig_pow(lbig *a, unsigned long n);
+
+/* Write A in decimal */
+void lbig_write(lbuf *b, lbig *a);
+
+#endif
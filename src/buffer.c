@@ -0,0 +1,122 @@
+#include "buffer.h"
+
+lbuf *lbuf_new(FILE *sink)
+{
+    lbuf *b = malloc(sizeof(lbuf));
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+    b->sink = sink;
+
+    return b;
+}
+
+void lbuf_del(lbuf *b)
+{
+    free(b->data);
+    free(b);
+}
+
+void lbuf_reserve(lbuf *b, size_t n)
+{
+    if (b->len + n <= b->cap)
+        return;
+
+    // Grow geometrically so appending stays amortised O(1)
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < b->len + n)
+        cap *= 2;
+
+    b->data = realloc(b->data, cap);
+    b->cap = cap;
+}
+
+void lbuf_putc(lbuf *b, char c)
+{
+    if (b->len == b->cap)
+        lbuf_reserve(b, 1);
+    b->data[b->len++] = c;
+}
+
+void lbuf_puts(lbuf *b, const char *s)
+{
+    lbuf_write(b, s, strlen(s));
+}
+
+void lbuf_write(lbuf *b, const char *s, size_t n)
+{
+    lbuf_reserve(b, n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+void lbuf_long(lbuf *b, long x)
+{
+    // Digits are produced backwards, unsigned to survive LONG_MIN
+    char digits[24];
+    int i = sizeof(digits);
+    unsigned long u = x < 0 ? -(unsigned long)x : (unsigned long)x;
+
+    do
+    {
+        digits[--i] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+
+    if (x < 0)
+        digits[--i] = '-';
+
+    lbuf_write(b, digits + i, sizeof(digits) - i);
+}
+
+void lbuf_double(lbuf *b, double x)
+{
+    char s[32];
+    for (int digits = 15; digits <= 17; digits++)
+    {
+        snprintf(s, sizeof(s), "%.*g", digits, x);
+        if (strtod(s, NULL) == x)
+            break;
+    }
+
+    lbuf_puts(b, s);
+    if (s[strspn(s, "-0123456789")] == '\0')
+        lbuf_puts(b, ".0");
+}
+
+void lbuf_printf(lbuf *b, const char *fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    int n = vsnprintf(NULL, 0, fmt, va);
+    va_end(va);
+
+    // vsnprintf always writes a terminator, reserve room for it
+    lbuf_reserve(b, n + 1);
+    va_start(va, fmt);
+    vsnprintf(b->data + b->len, n + 1, fmt, va);
+    va_end(va);
+    b->len += n;
+}
+
+void lbuf_flush(lbuf *b)
+{
+    if (!b->sink)
+        return;
+
+    if (b->len)
+        fwrite(b->data, 1, b->len, b->sink);
+    b->len = 0;
+}
+
+char *lbuf_take(lbuf *b)
+{
+    lbuf_putc(b, '\0');
+    char *s = realloc(b->data, b->len);
+
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+
+    return s;
+}
@@ -0,0 +1,46 @@
+#ifndef buffer_h
+#define buffer_h
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Growable byte buffer written to its SINK on explicit flush
+A buffer without a sink keeps everything until taken */
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    FILE *sink;
+} lbuf;
+
+/* Construct an empty buffer flushing to SINK, which may be NULL */
+lbuf *lbuf_new(FILE *sink);
+
+/* Free B without flushing it */
+void lbuf_del(lbuf *b);
+
+/* Ensure room for N more bytes */
+void lbuf_reserve(lbuf *b, size_t n);
+
+void lbuf_putc(lbuf *b, char c);
+void lbuf_puts(lbuf *b, const char *s);
+void lbuf_write(lbuf *b, const char *s, size_t n);
+void lbuf_long(lbuf *b, long x);
+void lbuf_printf(lbuf *b, const char *fmt, ...);
+
+/* Write X with the fewest digits reading back as it, up to 17
+Integral values keep a decimal point so they read back as floats */
+void lbuf_double(lbuf *b, double x);
+
+/* Write pending bytes to the sink in a single call and empty B
+Does nothing for buffers without a sink */
+void lbuf_flush(lbuf *b);
+
+/* Return the contents as a NUL terminated string owned by the caller
+B is left empty */
+char *lbuf_take(lbuf *b);
+
+#endif
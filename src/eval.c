@@ -1,114 +1,329 @@
 #include "eval.h"
+#include "bignum.h"
+#include "map.h"
+#include "memo.h"
+#include "memstats.h"
+#include "profile.h"
+#include "vector.h"
+
+/* ------------------------------------ */
+/* ---------- Interned Names ---------- */
+/* ------------------------------------ */
+
+/* Interned string, LOCALS counts its bindings in environments other than
+the global one, see lenv_find */
+typedef struct
+{
+    int locals;
+    char name[];
+} lname;
+
+// Open addressing table of interned names, at most half full, only grows
+static lname **interned = NULL;
+static size_t interned_cap = 0;
+static size_t interned_count = 0;
+
+static size_t lname_slot(const char *s)
+{
+    // FNV-1a
+    size_t h = 2166136261u;
+    for (const char *c = s; *c; c++)
+        h = (h ^ (unsigned char)*c) * 16777619u;
+
+    size_t i = h & (interned_cap - 1);
+    while (interned[i] && strcmp(interned[i]->name, s) != 0)
+        i = (i + 1) & (interned_cap - 1);
+
+    return i;
+}
+
+const char *lval_intern(const char *s)
+{
+    if ((interned_count + 1) * 2 > interned_cap)
+    {
+        lname **table = interned;
+        size_t cap = interned_cap;
+        interned_cap = cap ? cap * 2 : 256;
+        interned = calloc(interned_cap, sizeof(lname *));
+        for (size_t i = 0; i < cap; i++)
+            if (table[i])
+                interned[lname_slot(table[i]->name)] = table[i];
+        free(table);
+    }
+
+    size_t i = lname_slot(s);
+    if (!interned[i])
+    {
+        interned[i] = malloc(sizeof(lname) + strlen(s) + 1);
+        interned[i]->locals = 0;
+        strcpy(interned[i]->name, s);
+        interned_count++;
+    }
+
+    return interned[i]->name;
+}
+
+// Record of a string returned by lval_intern
+static lname *lname_of(const char *sym)
+{
+    return (lname *)(sym - offsetof(lname, name));
+}
 
 /* ------------------------------------ */
 /* ---------- LENV Functions ---------- */
 /* ------------------------------------ */
 
+// Environment builtins were added to, symbols resolve against it
+static lenv *lenv_global = NULL;
+
+/* Bumped whenever a name is added to the global environment, or another
+environment becomes the global one. Global slots cached on symbols are
+trusted while it is unchanged. Redefining a name replaces its value in
+place, so cached slots stay right */
+static unsigned long lenv_version = 1;
+
+// Keep LOCALS of SYM in step with a binding added to or removed from E
+static void lenv_count(lenv *e, const char *sym, int n)
+{
+    if (e != lenv_global)
+        lname_of(sym)->locals += n;
+}
+
 lenv *lenv_new(void)
 {
     lenv *e = malloc(sizeof(lenv));
     e->parent = NULL;
+    e->root = false;
     e->count = 0;
+    e->cap = 0;
+    e->borrowed = false;
     e->syms = NULL;
     e->vals = NULL;
 
     return e;
 }
 
-void lenv_del(lenv *e)
+// Drop every binding of E, and the storage of those unless borrowed
+static void lenv_clear(lenv *e)
 {
     for (size_t i = 0; i < e->count; i++)
     {
-        free(e->syms[i]);
+        lenv_count(e, e->syms[i], -1);
         lval_del(e->vals[i]);
     }
-    free(e->syms);
-    free(e->vals);
+    if (!e->borrowed)
+    {
+        free(e->syms);
+        free(e->vals);
+    }
+}
+
+void lenv_del(lenv *e)
+{
+    lenv_clear(e);
+    if (e == lenv_global)
+    {
+        lenv_global = NULL;
+        lenv_version++;
+    }
     free(e);
 }
 
-lval *lenv_get(lenv *e, lval *k)
+/* Environment of one call to a lambda, kept on the C stack
+Scoping is dynamic, lambdas never capture the environment they run in, so
+nothing holds on to a frame past its call */
+typedef struct
 {
-    for (size_t i = 0; i < e->count; i++)
-        if (strcmp(e->syms[i], k->sym) == 0)
-            return lval_copy(e->vals[i]);
+    lenv env;
+    const char *syms[LFRAME_SLOTS];
+    lval *vals[LFRAME_SLOTS];
+} lframe;
 
-    // Climb parent hierarchy to find symbol
-    if (e->parent)
-        return lenv_get(e->parent, k);
+static lenv *lframe_init(lframe *f, lenv *parent)
+{
+    f->env.parent = parent;
+    f->env.root = false;
+    f->env.count = 0;
+    f->env.cap = LFRAME_SLOTS;
+    f->env.borrowed = true;
+    f->env.syms = f->syms;
+    f->env.vals = f->vals;
 
-    return lval_err("Undefined Symbol '%s'", k->sym);
+    return &f->env;
 }
 
-lval *lenv_get_key(lenv *e, lval *k)
+// Index of SYM among the keys of E, -1 if unbound there
+static int lenv_index(lenv *e, const char *sym)
 {
-    for (size_t i = 0; i < e->count; i++)
-        // ! Very fishy, might require adaption for finding lambdas
-        if (e->vals[i]->builtin != NULL && e->vals[i]->builtin == k->builtin)
-            return lval_sym(e->syms[i]);
+    for (int i = 0; i < e->count; i++)
+        if (e->syms[i] == sym)
+            return i;
+
+    return -1;
+}
+
+/* Value bound to K seen from E, still owned by its environment, NULL if
+unbound. Scoping is dynamic, so the slot K was resolved to only holds while
+no nearer environment binds the same name */
+static lval *lenv_find(lenv *e, lval *k)
+{
+    // Parameter of the call DEPTH environments up
+    if (k->depth >= 0)
+    {
+        lenv *f = e;
+        int d = 0;
+        while (f && d < k->depth && lenv_index(f, k->sym) < 0)
+        {
+            f = f->parent;
+            d++;
+        }
+        if (f && d == k->depth && k->slot < f->count &&
+            f->syms[k->slot] == k->sym)
+            return f->vals[k->slot];
+    }
+
+    /* Global, straight to the slot cached on K when nothing else binds the
+    name. Only a new global name, which may fill a slot cached as missing,
+    makes it look again */
+    if (k->depth == LSYM_GLOBAL && lenv_global && !lname_of(k->sym)->locals)
+    {
+        if (k->version != lenv_version)
+        {
+            k->slot = lenv_index(lenv_global, k->sym);
+            k->version = lenv_version;
+        }
+        return k->slot >= 0 ? lenv_global->vals[k->slot] : NULL;
+    }
 
     // Climb parent hierarchy to find symbol
-    if (e->parent)
-        lenv_get_key(e->parent, k);
+    for (lenv *f = e; f; f = f->parent)
+    {
+        int i = lenv_index(f, k->sym);
+        if (i >= 0)
+        {
+            // Symbols found globally remember where, wherever they appear
+            if (f == lenv_global && k->depth < 0)
+            {
+                k->depth = LSYM_GLOBAL;
+                k->slot = i;
+                k->version = lenv_version;
+            }
+            return f->vals[i];
+        }
+    }
+
+    return NULL;
+}
 
-    return lval_err("Function not found");
+lval *lenv_get(lenv *e, lval *k)
+{
+    lval *v = lenv_find(e, k);
+    if (v)
+        return lval_copy(v);
+
+    return lval_err("Undefined Symbol '%s'", k->sym);
 }
 
 lenv *lenv_copy(lenv *e)
 {
     lenv *ne = malloc(sizeof(lenv));
     ne->parent = e->parent;
+    ne->root = e->root;
     ne->count = e->count;
+    ne->cap = e->count;
+    ne->borrowed = false;
     ne->syms = malloc(sizeof(char *) * e->count);
     ne->vals = malloc(sizeof(lval *) * e->count);
     for (size_t i = 0; i < ne->count; i++)
     {
-        ne->syms[i] = malloc(strlen(e->syms[i]) + 1);
-        strcpy(ne->syms[i], e->syms[i]);
+        ne->syms[i] = e->syms[i];
+        lenv_count(ne, ne->syms[i], 1);
         ne->vals[i] = lval_copy(e->vals[i]);
     }
 
     return ne;
 }
 
-int lenv_put(lenv *e, lval *k, lval *v)
+/* Bind SYM to V in E, taking ownership of V
+Return 1 if an existing binding was updated, 0 otherwise */
+static int lenv_set(lenv *e, const char *sym, lval *v)
 {
-    // If K exists in E, update value with new V
-    for (size_t i = 0; i < e->count; i++)
-        if (strcmp(e->syms[i], k->sym) == 0)
+    // If SYM exists in E, update value with new V
+    int i = lenv_index(e, sym);
+    if (i >= 0)
+    {
+        lval_del(e->vals[i]);
+        e->vals[i] = v;
+        return 1;
+    }
+
+    // Double the room for entries, borrowed storage is left as it is
+    if (e->count == e->cap)
+    {
+        e->cap = e->cap ? e->cap * 2 : 4;
+        if (e->borrowed)
         {
-            lval_del(e->vals[i]);
-            e->vals[i] = lval_copy(v);
-            return 1;
+            const char **syms = malloc(sizeof(char *) * e->cap);
+            lval **vals = malloc(sizeof(lval *) * e->cap);
+            memcpy(syms, e->syms, sizeof(char *) * e->count);
+            memcpy(vals, e->vals, sizeof(lval *) * e->count);
+            e->syms = syms;
+            e->vals = vals;
+            e->borrowed = false;
         }
+        else
+        {
+            e->syms = realloc(e->syms, sizeof(char *) * e->cap);
+            e->vals = realloc(e->vals, sizeof(lval *) * e->cap);
+        }
+    }
 
-    // Allocate memory for a new entry
-    e->count++;
-    e->syms = realloc(e->syms, sizeof(char *) * e->count);
-    e->vals = realloc(e->vals, sizeof(lval *) * e->count);
-
-    // Copy both K and V into respective lists
-    e->syms[e->count - 1] = malloc(strlen(k->sym) + 1);
-    strcpy(e->syms[e->count - 1], k->sym);
-    e->vals[e->count - 1] = lval_copy(v);
+    // Keys are interned, shared with the symbol
+    e->syms[e->count] = sym;
+    e->vals[e->count++] = v;
+    lenv_count(e, sym, 1);
+    if (e == lenv_global)
+        lenv_version++;
 
     return 0;
 }
 
+int lenv_put(lenv *e, lval *k, lval *v)
+{
+    return lenv_set(e, k->sym, lval_copy(v));
+}
+
 int lenv_def(lenv *e, lval *k, lval *v)
 {
-    // Update E to global environment
-    while (e->parent)
+    // Update E to global environment, or the session root
+    while (e->parent && !e->root)
         e = e->parent;
 
     return lenv_put(e, k, v);
 }
 
-void lenv_add_builtin(lenv *e, char *id, lbuiltin func)
+void lenv_add_builtin(lenv *e, lbuiltin_info *b)
 {
-    // Construct lvals from the ID and FUNC
-    lval *k = lval_sym(id);
-    lval *v = lval_fun(func);
+    // Count the arguments the signature asks for
+    bool optional = false;
+    b->min = b->max = 0;
+    for (const char *c = b->sig; *c; c++)
+    {
+        if (*c == '|')
+            optional = true;
+        else if (*c == '*')
+            b->max = LBUILTIN_VARIADIC;
+        else
+        {
+            b->max++;
+            b->min += !optional;
+        }
+    }
+
+    // Construct lvals from the name and entry
+    lval *k = lval_sym(b->name);
+    lval *v = lval_fun(b);
+    v->name = k->sym;
 
     // Insert both values in respective lists
     lenv_put(e, k, v);
@@ -117,103 +332,142 @@ void lenv_add_builtin(lenv *e, char *id, lbuiltin func)
     lval_del(v);
 }
 
+// Every builtin function, in the order they are bound
+static lbuiltin_info lbuiltins[] = {
+    {"load", builtin_load, "s", 0},
+    {"print", builtin_print, ".*", 0},
+    {"error", builtin_error, "s", 0},
+    {"mem-stats", builtin_mem_stats, "s", 0},
+
+    // Builtin List Functions
+    {"list", builtin_list, ".*", LBUILTIN_PURE},
+    {"head", builtin_head, "Q", LBUILTIN_PURE},
+    {"tail", builtin_tail, "Q", LBUILTIN_PURE},
+    {"eval", builtin_eval, "q", 0},
+    {"join", builtin_join, "q*", LBUILTIN_PURE},
+    {"cons", builtin_cons, "q.", LBUILTIN_PURE},
+    {"init", builtin_init, "q", LBUILTIN_PURE},
+    {"len", builtin_len, "q", LBUILTIN_PURE},
+
+    // Builtin Map Functions
+    {"map-new", builtin_map_new, "q", LBUILTIN_PURE},
+    {"map-get", builtin_map_get, "m.|.", LBUILTIN_PURE},
+    {"map-put", builtin_map_put, "m..", LBUILTIN_PURE},
+    {"map-del", builtin_map_del, "m.", LBUILTIN_PURE},
+    {"map-keys", builtin_map_keys, "m", LBUILTIN_PURE},
+    {"map-len", builtin_map_len, "m", LBUILTIN_PURE},
+    {"hash", builtin_hash, ".", LBUILTIN_PURE},
+
+    // Memoisation Functions
+    // The bound is checked after the function being a lambda
+    {"memo", builtin_memo, "f|.", 0},
+    {"memo-stats", builtin_memo_stats, "f", 0},
+
+    // Variable Functions
+    {"def", builtin_def, "q|.*", 0},
+    {"fun", builtin_fun, "qq", 0},
+    {"=", builtin_put, "q|.*", 0},
+    {"\\", builtin_lambda, "qq", 0},
+
+    // Builtin Arithmetic and Logic Functions
+    {"+", builtin_add, "n*", LBUILTIN_PURE},
+    {"-", builtin_sub, "n*", LBUILTIN_PURE},
+    {"*", builtin_mul, "n*", LBUILTIN_PURE},
+    {"/", builtin_div, "n*", LBUILTIN_PURE},
+    {"%", builtin_mod, "n*", LBUILTIN_PURE},
+    {"pow", builtin_pow, "n*", LBUILTIN_PURE},
+    {"min", builtin_min, "n*", LBUILTIN_PURE},
+    {"max", builtin_max, "n*", LBUILTIN_PURE},
+    {"if", builtin_if, "bqq", 0, form_if},
+    {">", builtin_gt, "nn", LBUILTIN_PURE},
+    {"<", builtin_lt, "nn", LBUILTIN_PURE},
+    {">=", builtin_ge, "nn", LBUILTIN_PURE},
+    {"<=", builtin_le, "nn", LBUILTIN_PURE},
+    {"==", builtin_eq, "..", LBUILTIN_PURE},
+    {"!=", builtin_neq, "..", LBUILTIN_PURE},
+    {"&&", builtin_and, "bb", LBUILTIN_PURE, form_and},
+    {"||", builtin_or, "bb", LBUILTIN_PURE, form_or},
+    {"!", builtin_not, "b", LBUILTIN_PURE},
+    {"true", builtin_true, ".*", LBUILTIN_PURE},
+    {"false", builtin_false, ".*", LBUILTIN_PURE},
+};
+
 void lenv_add_builtins(lenv *e)
 {
-    lenv_add_builtin(e, "load", builtin_load);
-    lenv_add_builtin(e, "print", builtin_print);
-    lenv_add_builtin(e, "error", builtin_error);
-
-    // Register Builtin List Functions
-    lenv_add_builtin(e, "list", builtin_list);
-    lenv_add_builtin(e, "head", builtin_head);
-    lenv_add_builtin(e, "tail", builtin_tail);
-    lenv_add_builtin(e, "eval", builtin_eval);
-    lenv_add_builtin(e, "join", builtin_join);
-    lenv_add_builtin(e, "cons", builtin_cons);
-    lenv_add_builtin(e, "init", builtin_init);
-    lenv_add_builtin(e, "len", builtin_len);
-
-    // Register Variable Functions
-    lenv_add_builtin(e, "def", builtin_def);
-    lenv_add_builtin(e, "fun", builtin_fun);
-    lenv_add_builtin(e, "=", builtin_put);
-    lenv_add_builtin(e, "\\", builtin_lambda);
-
-    // Register Builtin Arithmetic and Logic Functions
-    lenv_add_builtin(e, "+", builtin_add);
-    lenv_add_builtin(e, "-", builtin_sub);
-    lenv_add_builtin(e, "*", builtin_mul);
-    lenv_add_builtin(e, "/", builtin_div);
-    lenv_add_builtin(e, "%", builtin_mod);
-    lenv_add_builtin(e, "pow", builtin_pow);
-    lenv_add_builtin(e, "min", builtin_min);
-    lenv_add_builtin(e, "max", builtin_max);
-    lenv_add_builtin(e, "if", builtin_if);
-    lenv_add_builtin(e, ">", builtin_gt);
-    lenv_add_builtin(e, "<", builtin_lt);
-    lenv_add_builtin(e, ">=", builtin_ge);
-    lenv_add_builtin(e, "<=", builtin_le);
-    lenv_add_builtin(e, "==", builtin_eq);
-    lenv_add_builtin(e, "!=", builtin_neq);
-    lenv_add_builtin(e, "&&", builtin_and);
-    lenv_add_builtin(e, "||", builtin_or);
-    lenv_add_builtin(e, "!", builtin_not);
-    lenv_add_builtin(e, "true", builtin_true);
-    lenv_add_builtin(e, "false", builtin_false);
+    lenv_global = e;
+    lenv_version++;
+
+    for (size_t i = 0; i < sizeof(lbuiltins) / sizeof(lbuiltins[0]); i++)
+        lenv_add_builtin(e, &lbuiltins[i]);
 }
 
 /* ------------------------------------ */
 /* ---------- LVAL Functions ---------- */
 /* ------------------------------------ */
 
-lval *lval_empty()
+lval *lval_empty(int type)
 {
-    // Set every field to default null, except type
+    // Every field null, symbols start unresolved
     lval *v = malloc(sizeof(lval));
-    v->num = 0;
-    v->err = NULL;
-    v->bool = false;
-    v->str = NULL;
-    v->sym = NULL;
-    v->builtin = NULL;
-    v->env = NULL;
-    v->formals = NULL;
-    v->body = NULL;
-    v->count = 0;
-    v->cell = NULL;
+    memset(v, 0, sizeof(lval));
+    v->type = type;
+    mem_alloc(v);
+    if (type == LVAL_SYM)
+    {
+        v->depth = LSYM_UNRESOLVED;
+        v->slot = -1;
+    }
 
     return v;
 }
 
 lval *lval_num(long num)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_NUM;
+    lval *v = lval_empty(LVAL_NUM);
     v->num = num;
     return v;
 }
 
+lval *lval_big(lbig *a)
+{
+    long num;
+    if (lbig_to_long(a, &num))
+    {
+        lbig_del(a);
+        return lval_num(num);
+    }
+
+    lval *v = lval_num(a->sign < 0 ? LONG_MIN : LONG_MAX);
+    v->big = a;
+    return v;
+}
+
+lval *lval_double(double dbl)
+{
+    lval *v = lval_empty(LVAL_DOUBLE);
+    v->dbl = dbl;
+    return v;
+}
+
 lval *lval_bool(bool bool)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_BOOL;
+    lval *v = lval_empty(LVAL_BOOL);
     v->bool = bool;
     return v;
 }
 
 lval *lval_str(char *str)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_STR;
+    lval *v = lval_empty(LVAL_STR);
     v->str = malloc(strlen(str) + 1);
     strcpy(v->str, str);
+    mem_payload(v, strlen(str) + 1);
     return v;
 }
 
 lval *lval_err(char *fmt, ...)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_ERR;
+    lval *v = lval_empty(LVAL_ERR);
 
     // Create variadic array list and initialize
     va_list va;
@@ -225,65 +479,109 @@ lval *lval_err(char *fmt, ...)
 
     // Reallocate to bytes actually used
     v->err = realloc(v->err, strlen(v->err) + 1);
+    mem_payload(v, strlen(v->err) + 1);
 
     va_end(va);
 
     return v;
 }
 
-lval *lval_sym(char *symbol)
+lval *lval_sym(const char *symbol)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_SYM;
-    v->sym = malloc(strlen(symbol) + 1);
-    strcpy(v->sym, symbol);
+    lval *v = lval_empty(LVAL_SYM);
+    v->sym = lval_intern(symbol);
     return v;
 }
 
 lval *lval_sexpr(void)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_SEXPR;
-    v->count = 0;
-    v->cell = NULL;
-    return v;
+    return lval_empty(LVAL_SEXPR);
 }
 
-lval *lval_fun(lbuiltin func)
+lval *lval_fun(const lbuiltin_info *builtin)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_FUN;
-    v->builtin = func;
+    lval *v = lval_empty(LVAL_FUN);
+    v->builtin = builtin;
     return v;
 }
 
 lval *lval_qexpr(void)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_QEXPR;
-    v->count = 0;
-    v->cell = NULL;
-    return v;
+    return lval_empty(LVAL_QEXPR);
+}
+
+lval *lval_map(void)
+{
+    return lval_empty(LVAL_MAP);
+}
+
+static llambda *llambda_new(lenv *env, lval *formals, lval *body)
+{
+    llambda *l = malloc(sizeof(llambda));
+    l->refs = 1;
+    l->env = env;
+    lval_flatten(formals);
+    l->formals = formals;
+    l->body = body;
+
+    return l;
+}
+
+static void llambda_del(llambda *l)
+{
+    if (--l->refs)
+        return;
+
+    if (l->env)
+        lenv_del(l->env);
+    lval_del(l->formals);
+    lval_del(l->body);
+    free(l);
 }
 
 lval *lval_lambda(lval *formals, lval *body)
 {
-    lval *v = lval_empty();
-    v->type = LVAL_FUN;
+    lval *v = lval_empty(LVAL_FUN);
     v->builtin = NULL;
-    v->env = lenv_new();
-    v->formals = formals;
-    v->body = body;
+    v->lambda = llambda_new(NULL, formals, body);
 
     return v;
 }
 
+static lpair *lpair_new(lval *head, lpair *tail)
+{
+    lpair *p = malloc(sizeof(lpair));
+    mem_shared(LVAL_QEXPR, sizeof(lpair));
+    p->refs = 1;
+    p->head = head;
+    p->tail = tail;
+    p->hashed = false;
+
+    return p;
+}
+
+/* Drop a reference to P, freeing the links it was the last one of
+Walks the chain instead of recursing, lists can be long */
+static void lpair_del(lpair *p)
+{
+    while (p && --p->refs == 0)
+    {
+        lpair *tail = p->tail;
+        lval_del(p->head);
+        free(p);
+        p = tail;
+    }
+}
+
 void lval_del(lval *v)
 {
     switch (v->type)
     {
-    case LVAL_BOOL:
     case LVAL_NUM:
+        lbig_del(v->big);
+        break;
+    case LVAL_BOOL:
+    case LVAL_DOUBLE:
         // Nothing additional to free
         break;
     case LVAL_STR:
@@ -295,30 +593,39 @@ void lval_del(lval *v)
         free(v->err);
         break;
     case LVAL_SYM:
-        // Free symbol string allocation
-        free(v->sym);
+        // Symbol strings are interned
         break;
     case LVAL_FUN:
         if (!v->builtin)
         {
-            lenv_del(v->env);
-            lval_del(v->formals);
-            lval_del(v->body);
+            llambda_del(v->lambda);
+            lmemo_del(v->memo);
+            if (v->bound)
+                lval_del(v->bound);
         }
         break;
     case LVAL_QEXPR:
     case LVAL_SEXPR:
+        // Vectors and pairs release their elements with their last reference
+        lvec_del(v->vec);
+        lpair_del(v->pair);
         // Call lval_del on all elements within cell
-        for (size_t i = 0; i < v->count; i++)
+        for (size_t i = 0; !v->vec && !v->pair && i < v->count; i++)
             lval_del(v->cell[i]);
         // Free cell allocation
-        free(v->cell);
+        free(v->block);
+        if (v->folded)
+            lval_del(v->folded);
+        break;
+    case LVAL_MAP:
+        lmap_del(v->map);
         break;
     default:
         break;
     }
 
     // Free the memory on the lval struct itself
+    mem_free(v);
     free(v);
 }
 
@@ -326,8 +633,16 @@ lval *lval_read_num(mpc_ast_t *t)
 {
     // Canary variable for when conversion fails
     errno = 0;
+    // Floats have a point or an exponent, and only fail past the largest
+    if (strpbrk(t->contents, ".eE"))
+    {
+        double x = strtod(t->contents, NULL);
+        return isfinite(x) ? lval_double(x) : lval_err("invalid number");
+    }
+
+    // Integers past a long are read as bignums
     long x = strtol(t->contents, NULL, 10);
-    return errno != ERANGE ? lval_num(x) : lval_err("invalid number");
+    return errno != ERANGE ? lval_num(x) : lval_big(lbig_read(t->contents));
 }
 
 lval *lval_read_str(mpc_ast_t *t)
@@ -369,12 +684,7 @@ lval *lval_read(mpc_ast_t *t)
     // Add each valid sub-expression contained in the tree to new lval
     for (size_t i = 0; i < t->children_num; i++)
     {
-        if (strcmp(t->children[i]->contents, "(") == 0 ||
-            strcmp(t->children[i]->contents, ")") == 0 ||
-            strcmp(t->children[i]->contents, "{") == 0 ||
-            strcmp(t->children[i]->contents, "}") == 0 ||
-            strcmp(t->children[i]->tag, "regex") == 0 ||
-            strcmp(t->children[i]->tag, "comment") == 0)
+        if (lval_read_ignored(t->children[i]))
             continue;
 
         x = lval_add(x, lval_read(t->children[i]));
@@ -383,47 +693,258 @@ lval *lval_read(mpc_ast_t *t)
     return x;
 }
 
+int lval_read_ignored(mpc_ast_t *t)
+{
+    // Brackets, anchors and comments carry no value
+    return strcmp(t->contents, "(") == 0 || strcmp(t->contents, ")") == 0 ||
+           strcmp(t->contents, "{") == 0 || strcmp(t->contents, "}") == 0 ||
+           strcmp(t->tag, "regex") == 0 || strcmp(t->tag, "comment") == 0;
+}
+
+/* Ensure V has FRONT free slots before its cells and BACK after them
+A block at most half full is reused, otherwise its size doubles */
+static void lval_reserve(lval *v, size_t front, size_t back)
+{
+    size_t head = v->cell - v->block;
+    size_t tail = v->cap - head - v->count;
+    if (head >= front && tail >= back)
+        return;
+
+    size_t need = v->count + front + back;
+    size_t cap = v->cap;
+    while (cap < need * 2)
+        cap = cap ? cap * 2 : 4;
+
+    // Lists grown at the front keep their free slots there
+    size_t start = front ? cap - v->count - back : 0;
+    lval **block = malloc(sizeof(lval *) * cap);
+    mem_payload(v, sizeof(lval *) * cap);
+    if (v->count)
+        memcpy(block + start, v->cell, sizeof(lval *) * v->count);
+    free(v->block);
+
+    v->block = block;
+    v->cell = block + start;
+    v->cap = cap;
+}
+
+/* Move the cells of V into a vector */
+static void lval_vectorize(lval *v)
+{
+    v->vec = lvec_new(v->cell, v->count);
+    free(v->block);
+    v->cell = v->block = NULL;
+    v->cap = 0;
+}
+
+// Replace the vector of V, releasing the old one
+static void lval_set_vec(lval *v, lvec *vec)
+{
+    lvec_del(v->vec);
+    v->vec = vec;
+}
+
+/* Move the cells of V into linked pairs */
+static void lval_link(lval *v)
+{
+    lpair *p = NULL;
+    for (int i = v->count - 1; i >= 0; i--)
+        p = lpair_new(v->cell[i], p);
+
+    free(v->block);
+    v->cell = v->block = NULL;
+    v->cap = 0;
+    v->pair = p;
+}
+
+/* Remove the first pair of V, returning its element when KEEP is set
+The element is moved out of a link only V holds, copied out of a shared one */
+static lval *lval_unlink(lval *v, bool keep)
+{
+    lpair *p = v->pair;
+    lval *x = NULL;
+    v->pair = p->tail;
+    v->count--;
+
+    if (p->refs == 1)
+    {
+        // The reference to the tail moves to V
+        if (keep)
+            x = p->head;
+        else
+            lval_del(p->head);
+        free(p);
+        return x;
+    }
+
+    if (p->tail)
+        p->tail->refs++;
+    p->refs--;
+
+    return keep ? lval_copy(p->head) : NULL;
+}
+
+/* Walks the elements of a list in order, whatever its layout
+Pairs are followed link by link instead of counted from the front */
+typedef struct
+{
+    lval *list;
+    int i;
+    lpair *pair;
+} lcursor;
+
+static lcursor lcursor_of(lval *v)
+{
+    lcursor c = {v, 0, v->pair};
+    return c;
+}
+
+static lval *lcursor_next(lcursor *c)
+{
+    lval *x;
+    if (c->pair)
+    {
+        x = c->pair->head;
+        c->pair = c->pair->tail;
+    }
+    else
+        x = lval_nth(c->list, c->i);
+    c->i++;
+
+    return x;
+}
+
+lval *lval_nth(lval *v, int i)
+{
+    if (v->pair)
+    {
+        lpair *p = v->pair;
+        while (i--)
+            p = p->tail;
+        return p->head;
+    }
+
+    return v->vec ? lvec_get(v->vec, i) : v->cell[i];
+}
+
+void lval_flatten(lval *v)
+{
+    if (!v->vec && !v->pair)
+        return;
+
+    lval **cells = malloc(sizeof(lval *) * v->count);
+    mem_payload(v, sizeof(lval *) * v->count);
+    if (v->vec)
+    {
+        lvec_copy_to(v->vec, cells);
+        lval_set_vec(v, NULL);
+    }
+    else
+    {
+        // Links only V holds give up their elements, shared ones are copied
+        size_t n = 0;
+        lpair *p = v->pair;
+        while (p && p->refs == 1)
+        {
+            lpair *tail = p->tail;
+            cells[n++] = p->head;
+            free(p);
+            p = tail;
+        }
+        for (lpair *q = p; q; q = q->tail)
+            cells[n++] = lval_copy(q->head);
+        lpair_del(p);
+        v->pair = NULL;
+    }
+
+    v->block = v->cell = cells;
+    v->cap = v->count;
+}
+
 lval *lval_add(lval *v, lval *x)
 {
-    // Increment number of valid expressions
-    v->count++;
+    // Appending needs the last link, pairs are made cells again
+    if (v->pair)
+        lval_flatten(v);
 
-    // Reallocate more space for valid expressions
-    v->cell = realloc(v->cell, sizeof(lval *) * v->count);
+    if (v->vec)
+    {
+        lvec *last = lvec_new(&x, 1);
+        lval_set_vec(v, lvec_concat(v->vec, last));
+        lvec_del(last);
+        v->count++;
+        return v;
+    }
 
     // Append expression to list
-    v->cell[v->count - 1] = x;
+    lval_reserve(v, 0, 1);
+    v->cell[v->count++] = x;
 
     return v;
 }
 
 lval *lval_pop(lval *v, int i)
 {
+    if (v->pair && i == 0)
+        return lval_unlink(v, true);
+    if (v->pair)
+        lval_flatten(v);
+
+    // Vectors give a copy and join the parts around it
+    if (v->vec)
+    {
+        lval *x = lval_copy(lvec_get(v->vec, i));
+        lvec *before = lvec_slice(v->vec, 0, i);
+        lvec *after = lvec_slice(v->vec, i + 1, v->count);
+        lval_set_vec(v, lvec_concat(before, after));
+        lvec_del(before);
+        lvec_del(after);
+        v->count--;
+        return x;
+    }
+
     // Store lval at position i in cell
     lval *x = v->cell[i];
 
-    // Erase lval at position i in cell by shifting the remaining list towards
-    // it
-    // ! Very important
-    memmove(&v->cell[i], &v->cell[i + 1], sizeof(lval *) * (--v->count - i));
-
-    // Reallocate memory since we decreased pointer memory
-    v->cell = realloc(v->cell, sizeof(lval *) * v->count);
+    // Close the gap from the shorter side, popping the front is free
+    if (i < v->count / 2)
+    {
+        memmove(&v->cell[1], &v->cell[0], sizeof(lval *) * i);
+        v->cell++;
+    }
+    else
+        memmove(&v->cell[i], &v->cell[i + 1],
+                sizeof(lval *) * (v->count - i - 1));
+    v->count--;
 
     return x;
 }
 
 lval *lval_push(lval *v, lval *x)
 {
-    // Reallocate for one more [lval *] element
-    v->cell = realloc(v->cell, sizeof(lval *) * ++v->count);
+    if (v->vec)
+    {
+        lvec *first = lvec_new(&x, 1);
+        lval_set_vec(v, lvec_concat(first, v->vec));
+        lvec_del(first);
+        v->count++;
+        return v;
+    }
 
-    // Shift every element of the list to the right
-    // ! Very important -> -1 to not move out of bounds
-    memmove(&v->cell[1], &v->cell[0], sizeof(lval *) * (v->count - 1));
+    // Consing builds linked pairs, sharing the tail with every copy
+    if (v->type == LVAL_QEXPR)
+    {
+        if (!v->pair)
+            lval_link(v);
+        v->pair = lpair_new(x, v->pair);
+        v->count++;
+        return v;
+    }
 
     // Directly put x as first element
-    v->cell[0] = x;
+    lval_reserve(v, 1, 0);
+    *--v->cell = x;
+    v->count++;
 
     return v;
 }
@@ -432,11 +953,16 @@ lval *lval_copy(lval *v)
 {
     lval *x = malloc(sizeof(lval));
     x->type = v->type;
+    mem_alloc(x);
 
     switch (v->type)
     {
     case LVAL_NUM:
         x->num = v->num;
+        x->big = v->big ? lbig_ref(v->big) : NULL;
+        break;
+    case LVAL_DOUBLE:
+        x->dbl = v->dbl;
         break;
     case LVAL_BOOL:
         x->bool = v->bool;
@@ -444,32 +970,69 @@ lval *lval_copy(lval *v)
     case LVAL_STR:
         x->str = malloc(strlen(v->str) + 1);
         strcpy(x->str, v->str);
+        mem_payload(x, strlen(v->str) + 1);
         break;
     case LVAL_ERR:
         x->err = malloc(strlen(v->err) + 1);
         strcpy(x->err, v->err);
+        mem_payload(x, strlen(v->err) + 1);
         break;
     case LVAL_SYM:
-        x->sym = malloc(strlen(v->sym) + 1);
-        strcpy(x->sym, v->sym);
+        x->sym = v->sym;
+        x->depth = v->depth;
+        x->slot = v->slot;
+        x->version = v->version;
         break;
     case LVAL_FUN:
+        x->name = v->name;
+        x->memo = NULL;
+        x->bound = NULL;
         if (v->builtin)
             x->builtin = v->builtin;
         else
         {
+            // Lambdas never change, copies share them
             x->builtin = NULL;
-            x->env = lenv_copy(v->env);
-            x->formals = lval_copy(v->formals);
-            x->body = lval_copy(v->body);
+            x->lambda = v->lambda;
+            x->lambda->refs++;
+            if (v->memo)
+                x->memo = lmemo_ref(v->memo);
+            if (v->bound)
+                x->bound = lval_copy(v->bound);
         }
         break;
     case LVAL_QEXPR:
+        // Long lists are shared instead of copied, as are linked pairs
+        if (!v->vec && !v->pair && v->count >= LVEC_MIN)
+            lval_vectorize(v);
+        if (v->vec || v->pair)
+        {
+            x->vec = v->vec ? lvec_ref(v->vec) : NULL;
+            x->pair = v->pair;
+            if (v->pair)
+                v->pair->refs++;
+            x->count = v->count;
+            x->cell = x->block = NULL;
+            x->cap = 0;
+            x->folded = NULL;
+            break;
+        }
+        // Short lists are copied like S-Expressions
     case LVAL_SEXPR:
+        x->vec = NULL;
+        x->pair = NULL;
         x->count = v->count;
-        x->cell = malloc(sizeof(lval *) * x->count);
+        x->cap = v->count;
+        x->block = x->cell = malloc(sizeof(lval *) * x->count);
+        mem_payload(x, sizeof(lval *) * x->count);
         for (size_t i = 0; i < x->count; i++)
             x->cell[i] = lval_copy(v->cell[i]);
+        x->folded = v->folded ? lval_copy(v->folded) : NULL;
+        break;
+    case LVAL_MAP:
+        // Maps are persistent, copies share every node
+        x->map = v->map ? lmap_ref(v->map) : NULL;
+        break;
     default:
         break;
     }
@@ -485,103 +1048,346 @@ lval *lval_take(lval *v, int i)
     return x;
 }
 
+lval *lval_slice(lval *v, int start, int end)
+{
+    if (v->vec)
+    {
+        lval_set_vec(v, lvec_slice(v->vec, start, end));
+        v->count = end - start;
+        return v;
+    }
+
+    if (v->pair)
+    {
+        for (size_t i = 0; i < start; i++)
+            lval_unlink(v, false);
+        if (end - start == v->count)
+            return v;
+
+        // A kept prefix is unlinked into cells, the rest goes with its links
+        int n = end - start;
+        lval **cells = n ? malloc(sizeof(lval *) * n) : NULL;
+        mem_payload(v, sizeof(lval *) * n);
+        for (size_t i = 0; i < n; i++)
+            cells[i] = lval_unlink(v, true);
+        lpair_del(v->pair);
+        v->pair = NULL;
+        v->block = v->cell = cells;
+        v->cap = v->count = n;
+        return v;
+    }
+
+    for (size_t i = 0; i < start; i++)
+        lval_del(v->cell[i]);
+    for (size_t i = end; i < v->count; i++)
+        lval_del(v->cell[i]);
+    v->cell += start;
+    v->count = end - start;
+
+    return v;
+}
+
 lval *lval_join(lval *x, lval *y)
 {
-    // Add every element of y to x
-    while (y->count)
-        x = lval_add(x, lval_pop(y, 0));
+    // Cells joined in front of linked pairs are consed onto them
+    if (y->pair && !x->vec && !x->pair)
+    {
+        for (int i = x->count - 1; i >= 0; i--)
+            y->pair = lpair_new(x->cell[i], y->pair);
+        y->count += x->count;
+        x->count = 0;
+        lval_del(x);
+        return y;
+    }
+    if (x->pair)
+        lval_flatten(x);
+    if (y->pair)
+        lval_flatten(y);
+
+    // Long results are joined as vectors, sharing most of both
+    if (x->vec || y->vec || x->count + y->count >= LVEC_MIN)
+    {
+        if (!x->vec && x->count)
+            lval_vectorize(x);
+        if (!y->vec && y->count)
+            lval_vectorize(y);
+
+        lval_set_vec(x, lvec_concat(x->vec, y->vec));
+        x->count += y->count;
+        lval_del(y);
+        return x;
+    }
+
+    // Move every element of y to the end of x
+    lval_reserve(x, 0, y->count);
+    if (y->count)
+        memcpy(x->cell + x->count, y->cell, sizeof(lval *) * y->count);
+    x->count += y->count;
+    y->count = 0;
     lval_del(y);
 
     return x;
 }
 
-lval *lval_call(lenv *e, lval *f, lval *a)
+/* Whether GIVEN arguments fill every parameter F has left
+A '&' takes whatever follows the parameters before it */
+static bool lval_call_complete(lval *f, int given)
 {
-    // Builtin functions are called as normal
-    if (f->builtin)
-        return f->builtin(e, a);
+    lval *formals = f->lambda->formals;
+    for (size_t i = 0; i < formals->count; i++)
+        if (strcmp(formals->cell[i]->sym, "&") == 0)
+            return given >= i;
 
-    // Number of parameters, number of arguments
-    int expected = f->formals->count;
-    int given = a->count;
+    return given >= formals->count;
+}
 
-    while (a->count)
-    {
-        // Do not allow more arguments than parameters
-        if (f->formals->count == 0)
-        {
-            lval_del(a);
-            return lval_err(
-                "Function passed too many arguments -- Got %d, Expected %d",
-                given, expected);
-        }
-        // Pop first parameter
-        lval *sym = lval_pop(f->formals, 0);
+/* F expecting its formals from I on, the bindings of frame ENV kept for
+when the remaining arguments come */
+static lval *lval_partial(lval *f, lenv *env, int i)
+{
+    lval *formals = lval_qexpr();
+    for (size_t k = i; k < f->lambda->formals->count; k++)
+        lval_add(formals, lval_copy(f->lambda->formals->cell[k]));
 
-        // Special case to deal with variadic arguments
-        if (strcmp(sym->sym, "&") == 0)
-        {
+    lenv *bound = lenv_new();
+    for (size_t k = 0; k < env->count; k++)
+        lenv_set(bound, env->syms[k], lval_copy(env->vals[k]));
+
+    lval *x = lval_copy(f);
+    llambda_del(x->lambda);
+    x->lambda = llambda_new(bound, formals, lval_copy(f->lambda->body));
+
+    return x;
+}
+
+/* Bind arguments A to the formals of lambda F in a frame on top of E
+Kept apart from lval_call, calls to builtins do not reserve the frame */
+static lval *lval_call_lambda(lenv *e, lval *f, lval *a)
+{
+    static const char *rest = NULL;
+    if (!rest)
+        rest = lval_intern("&");
+
+    // Formals are never popped, parameter I takes argument J
+    lval *formals = f->lambda->formals;
+    int i = 0, j = 0;
+    lval *err = NULL;
+    lval_flatten(a);
+
+    // Arguments bound by partial application come first, in formal order
+    lframe frame;
+    lenv *env = lframe_init(&frame, e);
+    lenv *bound = f->lambda->env;
+    for (size_t k = 0; bound && k < bound->count; k++)
+        lenv_set(env, bound->syms[k], lval_copy(bound->vals[k]));
+
+    while (j < a->count)
+    {
+        // Do not allow more arguments than parameters
+        if (i == formals->count)
+        {
+            err = lval_err(
+                "Function passed too many arguments -- Got %d, Expected %d",
+                a->count, formals->count);
+            break;
+        }
+
+        // Special case to deal with variadic arguments
+        if (formals->cell[i]->sym == rest)
+        {
             // Ensure & is followed by only one other symbol
-            if (f->formals->count != 1)
+            if (formals->count - i != 2)
             {
-                lval_del(a);
-                return lval_err("Function format invalid -- Symbol '&' not "
-                                "followed by a single symbol");
+                err = lval_err("Function format invalid -- Symbol '&' not "
+                               "followed by a single symbol");
+                break;
             }
-            // Bind argument as Q-Expression list to parameter
-            lval *nsym = lval_pop(f->formals, 0);
-            lenv_put(f->env, nsym, builtin_list(e, a));
-            lval_del(nsym);
-            lval_del(sym);
+            // Bind remaining arguments as Q-Expression list to parameter
+            lval *list = lval_qexpr();
+            while (j < a->count)
+                lval_add(list, a->cell[j++]);
+            lenv_set(env, formals->cell[i + 1]->sym, list);
+            i += 2;
             break;
         }
 
-        // Pop first argument
-        // Bind argument to parameter in function's local environment
-        lval *val = lval_pop(a, 0);
-        lenv_put(f->env, sym, val);
-
-        lval_del(sym);
-        lval_del(val);
+        // Move argument into the frame, bound to its parameter
+        lenv_set(env, formals->cell[i++]->sym, a->cell[j++]);
     }
-    // Arguments have filled their purpose
+    // Arguments have filled their purpose, those not moved are deleted
+    a->cell += j;
+    a->count -= j;
     lval_del(a);
 
     // Incase '&' remains in formal list, bind to an empty list
-    if (f->formals->count > 0 && strcmp(f->formals->cell[0]->sym, "&") == 0)
+    if (!err && i < formals->count && formals->cell[i]->sym == rest)
     {
-        if (f->formals->count != 2)
+        if (formals->count - i != 2)
+            err = lval_err("Function format invalid -- Symbol '&' not "
+                           "followed by single symbol");
+        else
         {
-            return lval_err("Function format invalid -- Symbol '&' not "
-                            "followed by single symbol");
+            lenv_set(env, formals->cell[i + 1]->sym, lval_qexpr());
+            i += 2;
         }
-        // Delete '&'
-        lval_del(lval_pop(f->formals, 0));
-
-        // Pop next symbol, create empty list
-        lval *sym = lval_pop(f->formals, 0);
-        lval *val = lval_qexpr();
-
-        // Bind symbol to function's environment with val
-        lenv_put(f->env, sym, val);
-        lval_del(sym);
-        lval_del(val);
     }
 
     // Evaluate function if all parameters were filled with arguments
-    if (f->formals->count == 0)
+    lval *r = err;
+    if (!err && i == formals->count)
     {
-        // Add calling environment as parent
-        // Evaluate function body
-        f->env->parent = e;
-        return builtin_eval(f->env, lval_add(lval_sexpr(), lval_copy(f->body)));
+        // Calling environment is the parent of the frame, the body is only
+        // read, so what lookups learn about its symbols stays for next time
+        prof_push(f->name ? f->name : "lambda");
+        r = lval_eval_list(env, f->lambda->body);
+        prof_pop();
     }
     // Allow partially evaluated function to be bound
-    return lval_copy(f);
+    else if (!err)
+        r = lval_partial(f, env, i);
+
+    lenv_clear(env);
+
+    return r;
+}
+
+/* Call F through its memo cache, keyed on every argument bound since
+Partial applications are not cached, they carry the arguments they bound */
+static lval *lval_call_memo(lenv *e, lval *f, lval *a)
+{
+    lval *key = f->bound ? lval_copy(f->bound) : lval_qexpr();
+    key = lval_join(key, lval_copy(a));
+
+    bool complete = lval_call_complete(f, a->count);
+    lval *hit = complete ? lmemo_get(f->memo, key) : NULL;
+    if (hit)
+    {
+        lval_del(key);
+        lval_del(a);
+        return lval_copy(hit);
+    }
+
+    // The plain call, partial applications share the cache as copies of F
+    lval *r = lval_call_lambda(e, f, a);
+
+    if (!complete && r->type == LVAL_FUN)
+    {
+        if (r->bound)
+            lval_del(r->bound);
+        r->bound = key;
+    }
+    else if (complete && r->type != LVAL_ERR)
+        lmemo_put(f->memo, key, lval_copy(r));
+    else
+        lval_del(key);
+
+    return r;
+}
+
+// Type a signature character asks for, -1 when any will do
+static int lbuiltin_type(char c)
+{
+    switch (c)
+    {
+    case 'n':
+        return LVAL_NUM;
+    case 'b':
+        return LVAL_BOOL;
+    case 's':
+        return LVAL_STR;
+    case 'q':
+    case 'Q':
+        return LVAL_QEXPR;
+    case 'f':
+        return LVAL_FUN;
+    case 'm':
+        return LVAL_MAP;
+    default:
+        return -1;
+    }
+}
+
+/* Check the arguments A of a call to B against its signature
+Return NULL if they fit, otherwise the error B would have raised itself
+with A deleted */
+static lval *lbuiltin_check(const lbuiltin_info *b, lval *a)
+{
+    // Builtins with optional arguments check their own count
+    if (b->min == b->max)
+        LASSERT_NUMARGS(b->name, a, b->min);
+    if (a->count < b->min ||
+        (b->max != LBUILTIN_VARIADIC && a->count > b->max))
+        return NULL;
+
+    // After a trailing '*' the last character stands for the rest
+    const char *c = b->sig;
+    char t = '.';
+    for (int i = 0; i < a->count; i++)
+    {
+        if (*c == '|')
+            c++;
+        if (*c != '*')
+            t = *c++;
+
+        if (t == 'Q')
+            LASSERT_NON_EMPTY(b->name, a, i);
+        int type = lbuiltin_type(t);
+        if (type == LVAL_NUM && a->cell[i]->type == LVAL_DOUBLE)
+            continue;
+        if (type >= 0)
+            LASSERT_TYPE(b->name, a, i, type);
+    }
+
+    return NULL;
+}
+
+lval *lval_call(lenv *e, lval *f, lval *a)
+{
+    if (f->memo)
+        return lval_call_memo(e, f, a);
+
+    // Builtin functions are called as normal
+    if (f->builtin)
+    {
+        prof_push(f->name);
+        lval *r = lbuiltin_check(f->builtin, a);
+        if (!r)
+            r = f->builtin->func(e, a);
+        prof_pop();
+        return r;
+    }
+
+    return lval_call_lambda(e, f, a);
+}
+
+// Whether D is whole and within a long, so that a Number can equal it
+static bool lval_double_is_long(double d)
+{
+    return d >= -0x1p63 && d < 0x1p63 && d == (double)(long)d;
+}
+
+// Whether the Number X and the float D are the same value
+static bool lval_num_is(lval *x, double d)
+{
+    if (!x->big)
+        return lval_double_is_long(d) && (long)d == x->num;
+    if (!isfinite(d) || d != floor(d) || lbig_to_double(x->big) != d)
+        return false;
+
+    lbig *a = lbig_from_double(d);
+    bool eq = lbig_cmp(a, x->big) == 0;
+    lbig_del(a);
+    return eq;
 }
 
 bool lval_eq(lval *x, lval *y)
 {
+    // Numbers compare by value whatever their type
+    if (x->type == LVAL_NUM && y->type == LVAL_DOUBLE)
+        return lval_num_is(x, y->dbl);
+    if (x->type == LVAL_DOUBLE && y->type == LVAL_NUM)
+        return lval_eq(y, x);
+
     // Instant false on differing types
     if (x->type != y->type)
         return false;
@@ -589,8 +1395,14 @@ bool lval_eq(lval *x, lval *y)
     switch (x->type)
     {
     case LVAL_NUM:
+        // Bignums never hold a value a long could
+        if (x->big || y->big)
+            return x->big && y->big && lbig_cmp(x->big, y->big) == 0;
         return x->num == y->num;
         break;
+    case LVAL_DOUBLE:
+        return x->dbl == y->dbl;
+        break;
     case LVAL_BOOL:
         return x->bool == y->bool;
         break;
@@ -598,7 +1410,7 @@ bool lval_eq(lval *x, lval *y)
         return (strcmp(x->str, y->str) == 0);
         break;
     case LVAL_SYM:
-        return (strcmp(x->sym, y->sym) == 0);
+        return x->sym == y->sym;
         break;
     case LVAL_ERR:
         return (strcmp(x->err, y->err) == 0);
@@ -609,7 +1421,9 @@ bool lval_eq(lval *x, lval *y)
         if (x->builtin || y->builtin)
             return x->builtin == y->builtin;
         else
-            return lval_eq(x->formals, y->formals) && lval_eq(x->body, y->body);
+            return x->lambda == y->lambda ||
+                   (lval_eq(x->lambda->formals, y->lambda->formals) &&
+                    lval_eq(x->lambda->body, y->lambda->body));
         break;
     // Compare number of elements in their lists
     // Compare if every element of theirs is the same
@@ -617,11 +1431,17 @@ bool lval_eq(lval *x, lval *y)
     case LVAL_SEXPR:
         if (x->count != y->count)
             return false;
+        if ((x->vec && x->vec == y->vec) || (x->pair && x->pair == y->pair))
+            return true;
+        lcursor a = lcursor_of(x), b = lcursor_of(y);
         for (size_t i = 0; i < x->count; i++)
-            if (!lval_eq(x->cell[i], y->cell[i]))
+            if (!lval_eq(lcursor_next(&a), lcursor_next(&b)))
                 return false;
         return true;
         break;
+    case LVAL_MAP:
+        return lmap_eq(x->map, y->map);
+        break;
     default:
         break;
     }
@@ -629,39 +1449,156 @@ bool lval_eq(lval *x, lval *y)
     return false;
 }
 
+// Finaliser of splitmix64, spreads nearby inputs over every bit
+unsigned long lhash_mix(unsigned long h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9UL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebUL;
+    h ^= h >> 31;
+
+    return h;
+}
+
+// Fold X into the running hash H, the order of folds matters
+static unsigned long lhash_add(unsigned long h, unsigned long x)
+{
+    return lhash_mix(h ^ (x + 0x9e3779b97f4a7c15UL + (h << 6) + (h >> 2)));
+}
+
+// FNV-1a of S folded into H
+static unsigned long lhash_str(unsigned long h, const char *s)
+{
+    unsigned long f = 14695981039346656037UL;
+    for (; *s; s++)
+        f = (f ^ (unsigned char)*s) * 1099511628211UL;
+
+    return lhash_add(h, f);
+}
+
+static unsigned long lhash_big(unsigned long h, lbig *a)
+{
+    h = lhash_add(h, a->sign);
+    for (size_t i = 0; i < a->len; i++)
+        h = lhash_add(h, a->limb[i]);
+
+    return h;
+}
+
+/* List hash of the chain from P on, see LHASH_FACTOR
+Walks back from the first link already hashed, caching every link before */
+static unsigned long lpair_hash(lpair *p)
+{
+    size_t n = 0;
+    for (lpair *q = p; q && !q->hashed; q = q->tail)
+        n++;
+    if (!n)
+        return p->hash;
+
+    lpair **links = malloc(sizeof(lpair *) * n);
+    lpair *q = p;
+    for (size_t i = 0; i < n; i++, q = q->tail)
+        links[i] = q;
+
+    unsigned long hash = q ? q->hash : 0;
+    for (size_t i = n; i-- > 0;)
+    {
+        hash = lval_hash(links[i]->head) + hash * LHASH_FACTOR;
+        links[i]->hash = hash;
+        links[i]->hashed = true;
+    }
+    free(links);
+
+    return hash;
+}
+
+/* List hash of the elements of V, cells are rehashed on every call as they
+may still change */
+static unsigned long lval_hash_list(lval *v)
+{
+    if (v->vec)
+        return lvec_hash(v->vec);
+    if (v->pair)
+        return lpair_hash(v->pair);
+
+    unsigned long hash = 0;
+    for (int i = v->count - 1; i >= 0; i--)
+        hash = lval_hash(v->cell[i]) + hash * LHASH_FACTOR;
+
+    return hash;
+}
+
+unsigned long lval_hash(lval *v)
+{
+    // Values of different types never compare equal
+    unsigned long h = lhash_mix(v->type + 1);
+
+    switch (v->type)
+    {
+    case LVAL_NUM:
+        return v->big ? lhash_big(h, v->big) : lhash_add(h, v->num);
+    // Whole floats hash as the equal Number
+    case LVAL_DOUBLE:
+        if (lval_double_is_long(v->dbl))
+            return lhash_add(lhash_mix(LVAL_NUM + 1), (long)v->dbl);
+        if (isfinite(v->dbl) && v->dbl == floor(v->dbl))
+        {
+            lbig *a = lbig_from_double(v->dbl);
+            h = lhash_big(lhash_mix(LVAL_NUM + 1), a);
+            lbig_del(a);
+            return h;
+        }
+        unsigned long bits;
+        memcpy(&bits, &v->dbl, sizeof(bits));
+        return lhash_add(h, bits);
+    case LVAL_BOOL:
+        return lhash_add(h, v->bool);
+    case LVAL_STR:
+        return lhash_str(h, v->str);
+    case LVAL_SYM:
+        return lhash_str(h, v->sym);
+    case LVAL_ERR:
+        return lhash_str(h, v->err);
+    // Builtins by their function, lambdas by parameters and body
+    case LVAL_FUN:
+        if (v->builtin)
+            return lhash_add(h, (unsigned long)v->builtin->func);
+        return lhash_add(lhash_add(h, lval_hash(v->lambda->formals)),
+                         lval_hash(v->lambda->body));
+    case LVAL_QEXPR:
+    case LVAL_SEXPR:
+        return lhash_add(lhash_add(h, v->count), lval_hash_list(v));
+    // Entries are summed, equal maps may keep them in different orders
+    case LVAL_MAP:
+        return lhash_add(h, lmap_hash(v->map));
+    default:
+        break;
+    }
+
+    return h;
+}
+
 /* --------------------------------------------------------- */
 /* ---------- List Manipulation Builtin Functions ---------- */
 /* --------------------------------------------------------- */
 
 lval *builtin_head(lenv *e, lval *v)
 {
-    // Requires [one] [non-empty] [Q-Expression] argument
-    LASSERT_NUMARGS("head", v, 1);
-    LASSERT_NON_EMPTY("head", v, 0);
-    LASSERT_TYPE("head", v, 0, LVAL_QEXPR);
-
     // Take the first element of the Q-Expression
     // Return first, delete all remaining elements
     lval *x = lval_take(v, 0);
-    while (x->count > 1)
-        lval_del(lval_pop(x, 1));
 
-    return x;
+    return lval_slice(x, 0, 1);
 }
 
 lval *builtin_tail(lenv *e, lval *v)
 {
-    // Requires [one] [non-empty] [Q-Expression] argument
-    LASSERT_NUMARGS("tail", v, 1);
-    LASSERT_NON_EMPTY("tail", v, 0);
-    LASSERT_TYPE("tail", v, 0, LVAL_QEXPR);
-
     // Take the first element of the Q-Expression
     // Delete first element, return remaining
     lval *x = lval_take(v, 0);
-    lval_del(lval_pop(x, 0));
 
-    return x;
+    return lval_slice(x, 1, x->count);
 }
 
 lval *builtin_list(lenv *e, lval *v)
@@ -672,10 +1609,6 @@ lval *builtin_list(lenv *e, lval *v)
 
 lval *builtin_join(lenv *e, lval *v)
 {
-    // Requires every argument to be a Q-Expression
-    for (size_t i = 0; i < v->count; i++)
-        LASSERT_TYPE("join", v, i, LVAL_QEXPR);
-
     lval *x = lval_pop(v, 0);
     while (v->count)
         x = lval_join(x, lval_pop(v, 0));
@@ -686,11 +1619,8 @@ lval *builtin_join(lenv *e, lval *v)
 
 lval *builtin_eval(lenv *e, lval *v)
 {
-    // Requires [one] [Q-Expression] argument
-    LASSERT_NUMARGS("eval", v, 1);
-    LASSERT_TYPE("eval", v, 0, LVAL_QEXPR);
-
     lval *x = lval_take(v, 0);
+    lval_flatten(x);
     x->type = LVAL_SEXPR;
 
     return lval_eval(e, x);
@@ -699,10 +1629,6 @@ lval *builtin_eval(lenv *e, lval *v)
 lval *builtin_cons(lenv *e, lval *v)
 {
     // Takes a value and a Q-Expression and appends it to the front
-    // Requires [two] arguments, first is Q-Expression
-    LASSERT_NUMARGS("cons", v, 2);
-    LASSERT_TYPE("cons", v, 0, LVAL_QEXPR);
-
     // Pop first element
     // Pop second element and evaluate it
     lval *x = lval_pop(v, 0);
@@ -713,10 +1639,6 @@ lval *builtin_cons(lenv *e, lval *v)
 
 lval *builtin_len(lenv *e, lval *v)
 {
-    // Requires [one] [Q-Expression] argument
-    LASSERT_NUMARGS("len", v, 1);
-    LASSERT_TYPE("len", v, 0, LVAL_QEXPR);
-
     lval *x = lval_take(v, 0);
     long length = x->count;
     lval_del(x);
@@ -726,16 +1648,14 @@ lval *builtin_len(lenv *e, lval *v)
 
 lval *builtin_init(lenv *e, lval *v)
 {
-    // Requires [one] [Q-Expression] argument
-    LASSERT_NUMARGS("len", v, 1);
-    LASSERT_TYPE("len", v, 0, LVAL_QEXPR);
+    // Requires the [Q-Expression] to be [non-empty]
+    LASSERT_NON_EMPTY("init", v, 0);
 
     // Take everything except the last element of the Q-Expression
     // Delete last element, return remaining
     lval *x = lval_take(v, 0);
-    lval_del(lval_pop(x, x->count - 1));
 
-    return x;
+    return lval_slice(x, 0, x->count - 1);
 }
 
 lval *builtin_def(lenv *e, lval *v)
@@ -751,9 +1671,9 @@ lval *builtin_put(lenv *e, lval *v)
 lval *builtin_var(lenv *e, lval *v, char *func)
 {
     // Ensure first argument is a list of symbols
-    LASSERT_TYPE(func, v, 0, LVAL_QEXPR);
 
     lval *syms = v->cell[0];
+    lval_flatten(syms);
 
     // Ensure all following elements are also symbols
     for (size_t i = 0; i < syms->count; i++)
@@ -770,6 +1690,11 @@ lval *builtin_var(lenv *e, lval *v, char *func)
     // Insert key value pairs
     for (size_t i = 0; i < syms->count; i++)
     {
+        // Anonymous functions are known by their first binding
+        lval *val = v->cell[i + 1];
+        if (val->type == LVAL_FUN && !val->name)
+            val->name = lval_intern(syms->cell[i]->sym);
+
         if (strcmp(func, "def") == 0)
             lenv_def(e, syms->cell[i], v->cell[i + 1]);
         if (strcmp(func, "=") == 0)
@@ -780,13 +1705,213 @@ lval *builtin_var(lenv *e, lval *v, char *func)
     return lval_sexpr();
 }
 
-lval *builtin_lambda(lenv *e, lval *v)
+// Formals of a lambda being resolved, within those of the enclosing ones
+typedef struct lscope
 {
-    // Requires [two] [Q-Expressions]
-    LASSERT_NUMARGS("\\", v, 2);
-    LASSERT_TYPE("\\", v, 0, LVAL_QEXPR);
-    LASSERT_TYPE("\\", v, 1, LVAL_QEXPR);
+    lval *formals;
+    struct lscope *outer;
+} lscope;
+
+/* Slot SYM is bound to when a lambda of FORMALS is called, -1 if not one
+of them. Slots follow the order lval_call binds formals in, '&' takes none */
+static int lscope_slot(lval *formals, const char *sym)
+{
+    const char *rest = lval_intern("&");
+    int slot = 0;
+    lcursor c = lcursor_of(formals);
+    for (size_t i = 0; i < formals->count; i++)
+    {
+        lval *x = lcursor_next(&c);
+        if (x->type != LVAL_SYM || x->sym == rest)
+            continue;
+        if (x->sym == sym)
+            return slot;
+        slot++;
+    }
+
+    return -1;
+}
+
+/* Annotate the symbols of X with where a call will find them
+Formals of SCOPE resolve to their slot that many calls up, others to their
+global slot, left for lenv_find to fill in when not defined yet. Symbols of a
+nested lambda expression see its formals first */
+static void lval_resolve(lval *x, lscope *scope)
+{
+    if (x->type == LVAL_SYM)
+    {
+        int depth = 0;
+        for (lscope *s = scope; s; s = s->outer, depth++)
+        {
+            int slot = lscope_slot(s->formals, x->sym);
+            if (slot >= 0)
+            {
+                x->depth = depth;
+                x->slot = slot;
+                return;
+            }
+        }
+
+        // Resolved by an enclosing lambda already, which knows better
+        if (x->depth != LSYM_UNRESOLVED)
+            return;
+        x->depth = LSYM_GLOBAL;
+        x->slot = lenv_global ? lenv_index(lenv_global, x->sym) : -1;
+        x->version = lenv_version;
+        return;
+    }
+    if (x->type != LVAL_SEXPR && x->type != LVAL_QEXPR)
+        return;
+
+    lcursor c = lcursor_of(x);
+    lval *first = x->count == 3 ? lcursor_next(&c) : NULL;
+    lval *formals = first ? lcursor_next(&c) : NULL;
+    if (first && first->type == LVAL_SYM && first->sym == lval_intern("\\") &&
+        formals->type == LVAL_QEXPR)
+    {
+        lscope inner = {formals, scope};
+        lval_resolve(lcursor_next(&c), &inner);
+        return;
+    }
+
+    c = lcursor_of(x);
+    for (size_t i = 0; i < x->count; i++)
+        lval_resolve(lcursor_next(&c), scope);
+}
+
+/* Builtin HEAD names in E, when it is a pure one bound under its own name,
+NULL otherwise */
+static const lbuiltin_info *lval_fold_head(lenv *e, lval *head)
+{
+    lval *f = head->type == LVAL_SYM ? lenv_find(e, head) : NULL;
+    if (!f || f->type != LVAL_FUN || !f->builtin || f->name != head->sym)
+        return NULL;
+
+    return f->builtin->flags & LBUILTIN_PURE ? f->builtin : NULL;
+}
+
+// Value folded into X, NULL unless X is a folded call
+static lval *lval_folded(lval *x)
+{
+    return x->type == LVAL_SEXPR || x->type == LVAL_QEXPR ? x->folded : NULL;
+}
 
+// Bits of the magnitude of the Number X, bignums by whole limbs
+static double lval_bits(lval *x)
+{
+    if (x->big)
+        return x->big->len * 32.0;
+
+    double bits = 0;
+    for (unsigned long m = x->num < 0 ? -(unsigned long)x->num : x->num; m;
+         m >>= 1)
+        bits++;
+    return bits;
+}
+
+/* Whether calling B on A stays within LFOLD_BITS, worked out before calling
+Products and powers of integers are the only results that can outgrow their
+arguments without limit, anything involving a float stays a double */
+static bool lval_fold_small(const lbuiltin_info *b, lval *a)
+{
+    if (b->func != builtin_mul && b->func != builtin_pow)
+        return true;
+    for (size_t i = 0; i < a->count; i++)
+        if (a->cell[i]->type == LVAL_DOUBLE)
+            return true;
+
+    double bits = lval_bits(a->cell[0]);
+    for (size_t i = 1; i < a->count; i++)
+    {
+        lval *y = a->cell[i];
+        if (b->func == builtin_mul)
+            bits += lval_bits(y);
+        // Negative powers of integers round to a few bits at most
+        else if (y->big ? y->big->sign > 0 : y->num > 0)
+            bits *= y->big ? HUGE_VAL : y->num;
+        else
+            bits = 1;
+    }
+
+    return bits <= LFOLD_BITS;
+}
+
+/* Fold the S-Expressions within X calling pure builtins on numbers, strings,
+Q-Expressions or other folded calls, evaluating them once in E
+Heads bound to formals are left alone, as are calls ending in an error and
+products or powers past LFOLD_BITS */
+static void lval_fold(lenv *e, lval *x)
+{
+    if (x->type != LVAL_SEXPR && x->type != LVAL_QEXPR)
+        return;
+    if (x->folded)
+        return;
+
+    // Inner calls first, their values are the arguments of this one
+    bool constant = true;
+    lcursor c = lcursor_of(x);
+    for (size_t i = 0; i < x->count; i++)
+    {
+        lval *y = lcursor_next(&c);
+        lval_fold(e, y);
+        if (i > 0 && y->type != LVAL_NUM && y->type != LVAL_DOUBLE &&
+            y->type != LVAL_STR && y->type != LVAL_QEXPR && !lval_folded(y))
+            constant = false;
+    }
+    if (x->type != LVAL_SEXPR || x->count < 2 || !constant)
+        return;
+
+    c = lcursor_of(x);
+    lval *head = lcursor_next(&c);
+    const lbuiltin_info *b = head->type == LVAL_SYM && head->depth < 0
+                                  ? lval_fold_head(e, head)
+                                  : NULL;
+    if (!b)
+        return;
+
+    lval *a = lval_sexpr();
+    lval_reserve(a, 0, x->count - 1);
+    while (a->count < x->count - 1)
+    {
+        lval *y = lcursor_next(&c);
+        a->cell[a->count++] = lval_copy(lval_folded(y) ? y->folded : y);
+    }
+
+    lval *r = lbuiltin_check(b, a);
+    if (!r && !lval_fold_small(b, a))
+    {
+        lval_del(a);
+        return;
+    }
+    if (!r)
+        r = b->func(e, a);
+    if (r->type == LVAL_ERR)
+        lval_del(r);
+    else
+        x->folded = r;
+}
+
+/* Whether the value folded into X still stands in E, as long as the heads
+of X and the calls folded into it name the same builtins */
+static bool lval_fold_holds(lenv *e, lval *x)
+{
+    lcursor c = lcursor_of(x);
+    if (!lval_fold_head(e, lcursor_next(&c)))
+        return false;
+
+    for (size_t i = 1; i < x->count; i++)
+    {
+        lval *y = lcursor_next(&c);
+        if (lval_folded(y) && !lval_fold_holds(e, y))
+            return false;
+    }
+
+    return true;
+}
+
+lval *builtin_lambda(lenv *e, lval *v)
+{
+    lval_flatten(v->cell[0]);
     for (size_t i = 0; i < v->cell[0]->count; i++)
         LASSERT(v, (v->cell[0]->cell[i]->type == LVAL_SYM),
                 "Cannot define non-symbol -- Got %s, Expected %s",
@@ -797,41 +1922,46 @@ lval *builtin_lambda(lenv *e, lval *v)
     lval *body = lval_pop(v, 0);
     lval_del(v);
 
+    lval_resolve(body, &(lscope){formals, NULL});
+    lval_fold(e, body);
+
     return lval_lambda(formals, body);
 }
 
 lval *builtin_fun(lenv *e, lval *v)
 {
-    // Requires [two] [Q-Expressions]
-    LASSERT_NUMARGS("fun", v, 2);
-    LASSERT_TYPE("fun", v, 0, LVAL_QEXPR);
-    LASSERT_TYPE("fun", v, 1, LVAL_QEXPR);
-
     // def {fun} (\ {args body} {def (head args) (\ (tail args) body)})
     // fun {sum x y} {+ x y}
     // ? fun {sum x & xs} {+ xs}
     lval *signature = lval_pop(v, 0);
     lval *body = lval_pop(v, 0);
     lval *name = lval_pop(signature, 0);
+    lval_del(v);
 
     // signature is now args
-    lenv_def(e, name, lval_lambda(signature, body));
+    lval_resolve(body, &(lscope){signature, NULL});
+    lval_fold(e, body);
+    lval *f = lval_lambda(signature, body);
+    f->name = lval_intern(name->sym);
+    lenv_def(e, name, f);
 
     lval_del(name);
-    lval_del(body);
-    lval_del(signature);
+    lval_del(f);
 
     return lval_sexpr();
 }
 
 lval *builtin_print(lenv *e, lval *v)
 {
+    // Whole line is assembled first and written once
+    lbuf *b = lval_get_output();
     for (size_t i = 0; i < v->count; i++)
     {
-        lval_print(e, v->cell[i]);
-        putchar(' ');
+        lval_write(b, e, v->cell[i]);
+        lbuf_putc(b, ' ');
     }
-    putchar('\n');
+    lbuf_putc(b, '\n');
+    lbuf_flush(b);
     lval_del(v);
 
     return lval_sexpr();
@@ -839,87 +1969,315 @@ lval *builtin_print(lenv *e, lval *v)
 
 lval *builtin_error(lenv *e, lval *v)
 {
-    LASSERT_NUMARGS("error", v, 1);
-    LASSERT_TYPE("error", v, 0, LVAL_STR);
-
     lval *err = lval_err(v->cell[0]->str);
     lval_del(v);
 
     return err;
 }
 
+/* ------------------------------------------- */
+/* ---------- Map Builtin Functions ---------- */
+/* ------------------------------------------- */
+
+// Bind K to X in map M, replacing its nodes
+static void lval_map_put(lval *m, lval *k, lval *x)
+{
+    lmap *map = lmap_put(m->map, k, x);
+    lmap_del(m->map);
+    m->map = map;
+}
+
+lval *builtin_map_new(lenv *e, lval *v)
+{
+    // Requires keys and values in pairs
+    LASSERT(v, v->cell[0]->count % 2 == 0,
+            "Function map-new expects keys and values in pairs -- Got %d "
+            "elements",
+            v->cell[0]->count);
+
+    lval *kvs = lval_take(v, 0);
+    lval_flatten(kvs);
+
+    lval *m = lval_map();
+    while (kvs->count)
+    {
+        lval *k = lval_pop(kvs, 0);
+        lval_map_put(m, k, lval_pop(kvs, 0));
+    }
+    lval_del(kvs);
+
+    return m;
+}
+
+lval *builtin_map_get(lenv *e, lval *v)
+{
+    LASSERT(v, v->count == 2 || v->count == 3,
+            "Function map-get non compatible arity -- Got %d, Expected 2 or 3",
+            v->count);
+
+    lval *x = lmap_get(v->cell[0]->map, v->cell[1]);
+    if (x)
+        x = lval_copy(x);
+    else if (v->count == 3)
+        x = lval_pop(v, 2);
+    else
+    {
+        char *k = lval_to_str(e, v->cell[1]);
+        x = lval_err("Key %s not found in map", k);
+        free(k);
+    }
+    lval_del(v);
+
+    return x;
+}
+
+lval *builtin_map_put(lenv *e, lval *v)
+{
+    lval *m = lval_pop(v, 0);
+    lval *k = lval_pop(v, 0);
+    lval_map_put(m, k, lval_take(v, 0));
+
+    return m;
+}
+
+lval *builtin_map_del(lenv *e, lval *v)
+{
+    lval *m = lval_pop(v, 0);
+    lmap *map = lmap_remove(m->map, v->cell[0]);
+    lmap_del(m->map);
+    m->map = map;
+    lval_del(v);
+
+    return m;
+}
+
+lval *builtin_map_keys(lenv *e, lval *v)
+{
+    lval *m = lval_take(v, 0);
+    size_t n = lmap_size(m->map);
+    lval **keys = malloc(sizeof(lval *) * (n + 1));
+    lmap_entries(m->map, keys, NULL);
+
+    lval *x = lval_qexpr();
+    for (size_t i = 0; i < n; i++)
+        lval_add(x, lval_copy(keys[i]));
+    free(keys);
+    lval_del(m);
+
+    return x;
+}
+
+lval *builtin_map_len(lenv *e, lval *v)
+{
+    lval *m = lval_take(v, 0);
+    long length = lmap_size(m->map);
+    lval_del(m);
+
+    return lval_num(length);
+}
+
+lval *builtin_hash(lenv *e, lval *v)
+{
+    lval *x = lval_take(v, 0);
+    long hash = lval_hash(x);
+    lval_del(x);
+
+    return lval_num(hash);
+}
+
 /* -------------------------------------------------- */
 /* ---------- Arithmetic Builtin Functions ---------- */
 /* -------------------------------------------------- */
 
-lval *builtin_op(lenv *e, lval *v, char *op)
+// Value of the Number or Double V as a double
+static double lval_real(lval *v)
 {
-    // Ensure all arguments are numbers
-    for (size_t i = 0; i < v->count; i++)
-        LASSERT_TYPE(op, v, i, LVAL_NUM);
+    if (v->type == LVAL_DOUBLE)
+        return v->dbl;
 
-    // Attempt to perform unary negation
-    lval *x = lval_pop(v, 0);
-    if ((strcmp(op, "-") == 0) && v->count == 0)
-        x->num = -x->num;
+    return v->big ? lbig_to_double(v->big) : v->num;
+}
 
-    // Calculate expressions normally
-    while (v->count > 0)
+// Bignum of the value of the Number V, a new reference
+static lbig *lval_to_big(lval *v)
+{
+    return v->big ? lbig_ref(v->big) : lbig_from_long(v->num);
+}
+
+// X to the power N in R, N not negative. False if it overflows a long
+static bool lval_pow_long(long x, long n, long *r)
+{
+    *r = 1;
+    while (n)
     {
-        // LVAL_POP decreases v->count
-        lval *y = lval_pop(v, 0);
+        if ((n & 1) && __builtin_mul_overflow(*r, x, r))
+            return false;
+        n >>= 1;
+        if (n && __builtin_mul_overflow(x, x, &x))
+            return false;
+    }
 
-        if (strcmp(op, "+") == 0)
-            x->num += y->num;
+    return true;
+}
 
-        if (strcmp(op, "-") == 0)
-            x->num -= y->num;
+/* Apply OP to the fixnums *X and Y, storing the result in *X
+False when it overflows a long, leaving *X as it was */
+static bool builtin_op_long(long *x, long y, char *op)
+{
+    long r;
+    bool exact = true;
 
-        if (strcmp(op, "*") == 0)
-            x->num *= y->num;
+    if (strcmp(op, "+") == 0)
+        exact = !__builtin_add_overflow(*x, y, &r);
+    else if (strcmp(op, "-") == 0)
+        exact = !__builtin_sub_overflow(*x, y, &r);
+    else if (strcmp(op, "*") == 0)
+        exact = !__builtin_mul_overflow(*x, y, &r);
+    else if (strcmp(op, "min") == 0)
+        r = *x < y ? *x : y;
+    else if (strcmp(op, "max") == 0)
+        r = *x >= y ? *x : y;
+    else if (strcmp(op, "/") == 0)
+    {
+        // LONG_MIN / -1 is the only quotient past a long
+        exact = !(*x == LONG_MIN && y == -1);
+        r = exact ? *x / y : 0;
+    }
+    else if (strcmp(op, "%") == 0)
+        r = y == -1 ? 0 : *x % y;
+    else
+        exact = lval_pow_long(*x, y, &r);
 
-        if (strcmp(op, "min") == 0)
-            x->num = x->num < y->num ? x->num : y->num;
+    if (exact)
+        *x = r;
+    return exact;
+}
 
-        if (strcmp(op, "max") == 0)
-            x->num = x->num >= y->num ? x->num : y->num;
+/* Exact kernel of builtin_op, X OP Y on bignums
+Takes ownership of X, Y is left to the caller. The result drops back to a
+fixnum when it fits */
+static lval *builtin_op_big(lval *x, lval *y, char *op)
+{
+    lbig *a = lval_to_big(x);
+    lbig *b = lval_to_big(y);
+    lbig *r = NULL;
+    lval_del(x);
 
-        if (strcmp(op, "/") == 0)
+    if (strcmp(op, "+") == 0)
+        r = lbig_add(a, b);
+    else if (strcmp(op, "-") == 0)
+        r = lbig_sub(a, b);
+    else if (strcmp(op, "*") == 0)
+        r = lbig_mul(a, b);
+    else if (strcmp(op, "min") == 0)
+        r = lbig_ref(lbig_cmp(a, b) < 0 ? a : b);
+    else if (strcmp(op, "max") == 0)
+        r = lbig_ref(lbig_cmp(a, b) >= 0 ? a : b);
+    else if (strcmp(op, "/") == 0)
+        r = lbig_div(a, b, NULL);
+    else if (strcmp(op, "%") == 0)
+        lbig_del(lbig_div(a, b, &r));
+    else if (!y->big)
+        r = lbig_pow(a, y->num);
+    /* Past a long only powers of 0, 1 and -1 fit in memory, the parity of the
+    exponent is enough for those */
+    else if (!a->len || (a->len == 1 && a->limb[0] == 1))
+        r = lbig_pow(a, 2 - (b->limb[0] & 1));
+    lbig_del(a);
+    lbig_del(b);
+
+    return r ? lval_big(r) : lval_err("Exponent too large");
+}
+
+// Float kernel of builtin_op, every argument is promoted to a double
+static lval *builtin_op_double(lval *v, char *op)
+{
+    double x = lval_real(v->cell[0]);
+    if ((strcmp(op, "-") == 0) && v->count == 1)
+        x = -x;
+
+    for (size_t i = 1; i < v->count; i++)
+    {
+        double y = lval_real(v->cell[i]);
+
+        if (strcmp(op, "+") == 0)
+            x += y;
+        else if (strcmp(op, "-") == 0)
+            x -= y;
+        else if (strcmp(op, "*") == 0)
+            x *= y;
+        else if (strcmp(op, "min") == 0)
+            x = x < y ? x : y;
+        else if (strcmp(op, "max") == 0)
+            x = x >= y ? x : y;
+        else if (strcmp(op, "pow") == 0)
+            x = pow(x, y);
+        else if (y == 0)
         {
-            if (y->num == 0)
-            {
-                lval_del(x);
-                lval_del(y);
-                x = lval_err("Division by Zero");
-                break;
-            }
-            x->num /= y->num;
+            lval_del(v);
+            return lval_err("Division by Zero");
         }
+        else if (strcmp(op, "/") == 0)
+            x /= y;
+        else
+            x = fmod(x, y);
+    }
+    lval_del(v);
 
-        if (strcmp(op, "%") == 0)
+    // Infinities and NaNs could not be read back
+    return isfinite(x) ? lval_double(x) : lval_err("Float result not finite");
+}
+
+lval *builtin_op(lenv *e, lval *v, char *op)
+{
+    // Integers keep their own kernel unless a float is involved
+    for (size_t i = 0; i < v->count; i++)
+        if (v->cell[i]->type == LVAL_DOUBLE)
+            return builtin_op_double(v, op);
+
+    // Attempt to perform unary negation, -LONG_MIN needs a bignum
+    lval *x = lval_pop(v, 0);
+    if ((strcmp(op, "-") == 0) && v->count == 0)
+    {
+        if (x->big || x->num == LONG_MIN)
         {
-            if (y->num == 0)
-            {
-                lval_del(x);
-                lval_del(y);
-                x = lval_err("Division by Zero");
-                break;
-            }
-            x->num %= y->num;
+            lbig *a = lval_to_big(x);
+            lval_del(x);
+            x = lval_big(lbig_neg(a));
+            lbig_del(a);
         }
+        else
+            x->num = -x->num;
+    }
 
-        if (strcmp(op, "pow") == 0)
+    // Calculate expressions normally
+    while (v->count > 0)
+    {
+        // LVAL_POP decreases v->count
+        lval *y = lval_pop(v, 0);
+
+        // Bignums clamp NUM to their sign, enough to tell zero and negatives
+        if ((strcmp(op, "/") == 0 || strcmp(op, "%") == 0) && y->num == 0)
         {
-            if (y->num < 0)
-            {
-                lval_del(x);
-                lval_del(y);
-                x = lval_err("Negative Exponent");
-                break;
-            }
-            x->num = pow(x->num, y->num);
+            lval_del(x);
+            lval_del(y);
+            x = lval_err("Division by Zero");
+            break;
+        }
+        if (strcmp(op, "pow") == 0 && y->num < 0)
+        {
+            lval_del(x);
+            lval_del(y);
+            x = lval_err("Negative Exponent");
+            break;
         }
+
+        // Fixnums stay on longs until a result overflows
+        if (x->big || y->big || !builtin_op_long(&x->num, y->num, op))
+            x = builtin_op_big(x, y, op);
         lval_del(y);
+        if (x->type == LVAL_ERR)
+            break;
     }
     lval_del(v);
 
@@ -964,21 +2322,35 @@ lval *builtin_max(lenv *e, lval *v)
 
 lval *builtin_ord(lenv *e, lval *v, char *op)
 {
-    // Requires [two] [numbers]
-    LASSERT_NUMARGS(op, v, 2);
-    LASSERT_TYPE(op, v, 0, LVAL_NUM);
-    LASSERT_TYPE(op, v, 1, LVAL_NUM);
+    // Integers compare exactly, a float makes it a comparison of doubles
+    lval *a = v->cell[0];
+    lval *b = v->cell[1];
+    bool exact = a->type == LVAL_NUM && b->type == LVAL_NUM;
+    double x = lval_real(a);
+    double y = lval_real(b);
+
+    // Bignums compare exactly too, through the sign lbig_cmp gives
+    if (exact && (a->big || b->big))
+    {
+        lbig *p = lval_to_big(a);
+        lbig *q = lval_to_big(b);
+        x = lbig_cmp(p, q);
+        y = 0;
+        exact = false;
+        lbig_del(p);
+        lbig_del(q);
+    }
 
     // False -> 0
     lval *r = NULL;
     if (strcmp(op, ">") == 0)
-        r = lval_bool(v->cell[0]->num > v->cell[1]->num);
+        r = lval_bool(exact ? a->num > b->num : x > y);
     if (strcmp(op, "<") == 0)
-        r = lval_bool(v->cell[0]->num < v->cell[1]->num);
+        r = lval_bool(exact ? a->num < b->num : x < y);
     if (strcmp(op, ">=") == 0)
-        r = lval_bool(v->cell[0]->num >= v->cell[1]->num);
+        r = lval_bool(exact ? a->num >= b->num : x >= y);
     if (strcmp(op, "<=") == 0)
-        r = lval_bool(v->cell[0]->num <= v->cell[1]->num);
+        r = lval_bool(exact ? a->num <= b->num : x <= y);
     lval_del(v);
 
     return r;
@@ -1001,9 +2373,6 @@ lval *builtin_le(lenv *e, lval *v)
 }
 lval *builtin_cmp(lenv *e, lval *v, char *op)
 {
-    // Requires [two] arguments
-    LASSERT_NUMARGS(op, v, 2);
-
     // False -> 0
     lval *r = NULL;
     if (strcmp(op, "==") == 0)
@@ -1032,49 +2401,31 @@ lval *builtin_false(lenv *e, lval *v)
 }
 lval *builtin_if(lenv *e, lval *v)
 {
-    // Requires [three] arguments - one [bool] two [Q-Expression]
-    LASSERT_NUMARGS("if", v, 3);
-    LASSERT_TYPE("if", v, 0, LVAL_BOOL);
-    LASSERT_TYPE("if", v, 1, LVAL_QEXPR);
-    LASSERT_TYPE("if", v, 2, LVAL_QEXPR);
-
-    lval *x;
-    v->cell[1]->type = LVAL_SEXPR;
-    v->cell[2]->type = LVAL_SEXPR;
-
-    x = v->cell[0]->bool ? lval_eval(e, lval_pop(v, 1))
-                         : lval_eval(e, lval_pop(v, 2));
+    lval *x = lval_pop(v, v->cell[0]->bool ? 1 : 2);
     lval_del(v);
+    lval_flatten(x);
+    x->type = LVAL_SEXPR;
 
-    return x;
+    return lval_eval(e, x);
 }
 lval *builtin_and(lenv *e, lval *v)
 {
-    LASSERT_NUMARGS("&&", v, 2);
-    LASSERT_TYPE("&&", v, 0, LVAL_BOOL);
-    LASSERT_TYPE("&&", v, 1, LVAL_BOOL);
-
     lval *x = lval_pop(v, 0);
-    x->bool = x->bool && lval_take(v, 0)->bool;
+    x->bool = x->bool && v->cell[0]->bool;
+    lval_del(v);
 
     return x;
 }
 lval *builtin_or(lenv *e, lval *v)
 {
-    LASSERT_NUMARGS("||", v, 2);
-    LASSERT_TYPE("||", v, 0, LVAL_BOOL);
-    LASSERT_TYPE("||", v, 1, LVAL_BOOL);
-
     lval *x = lval_pop(v, 0);
-    x->bool = x->bool || lval_take(v, 0)->bool;
+    x->bool = x->bool || v->cell[0]->bool;
+    lval_del(v);
 
     return x;
 }
 lval *builtin_not(lenv *e, lval *v)
 {
-    LASSERT_NUMARGS("!", v, 1);
-    LASSERT_TYPE("!", v, 0, LVAL_BOOL);
-
     lval *x = lval_pop(v, 0);
     x->bool = !x->bool;
 
@@ -1085,6 +2436,21 @@ lval *builtin_not(lenv *e, lval *v)
 /* ---------- PRINT  ---------- */
 /* ---------------------------- */
 
+// Destination of every printing function, stdout unless redirected
+static lbuf *lout = NULL;
+
+void lval_set_output(lbuf *b)
+{
+    lout = b;
+}
+
+lbuf *lval_get_output(void)
+{
+    if (!lout)
+        lout = lbuf_new(stdout);
+    return lout;
+}
+
 char *ltype_name(int t)
 {
     switch (t)
@@ -1113,6 +2479,12 @@ char *ltype_name(int t)
     case LVAL_QEXPR:
         return "Q-Expression";
         break;
+    case LVAL_MAP:
+        return "Map";
+        break;
+    case LVAL_DOUBLE:
+        return "Double";
+        break;
     default:
         return "Unknown";
         break;
@@ -1121,104 +2493,370 @@ char *ltype_name(int t)
 
 void lenv_print_definitions(lenv *e)
 {
+    lbuf *b = lval_get_output();
     for (size_t i = 0; i < e->count; i++)
-        printf("%s ", e->syms[i]);
-    putchar('\n');
+    {
+        lbuf_puts(b, e->syms[i]);
+        lbuf_putc(b, ' ');
+    }
+    lbuf_putc(b, '\n');
+    lbuf_flush(b);
 }
 
-void lval_expr_print(lenv *e, lval *v, char open, char close)
+void lval_expr_print(lbuf *b, lenv *e, lval *v, char open, char close)
 {
-    putchar(open);
+    lbuf_putc(b, open);
+    lcursor c = lcursor_of(v);
     for (size_t i = 0; i < v->count; i++)
     {
-        lval_print(e, v->cell[i]);
+        lval_write(b, e, lcursor_next(&c));
 
         // Avoid trailing space if not end
         if (i != (v->count - 1))
-            putchar(' ');
+            lbuf_putc(b, ' ');
     }
-    putchar(close);
+    lbuf_putc(b, close);
 }
 
-void lval_print_str(lenv *e, lval *v)
+void lval_map_print(lbuf *b, lenv *e, lval *v)
 {
-    // Copy and escape string
-    char *escaped = malloc(strlen(v->str) + 1);
-    strcpy(escaped, v->str);
-    escaped = mpcf_escape(escaped);
+    size_t n = lmap_size(v->map);
+    lval **keys = malloc(sizeof(lval *) * (n + 1));
+    lval **vals = malloc(sizeof(lval *) * (n + 1));
+    lmap_entries(v->map, keys, vals);
+
+    lbuf_puts(b, "#{");
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i)
+            lbuf_puts(b, ", ");
+        lval_write(b, e, keys[i]);
+        lbuf_putc(b, ' ');
+        lval_write(b, e, vals[i]);
+    }
+    lbuf_putc(b, '}');
 
-    // Printf between quotes and free allocation
-    printf("\"%s\"", escaped);
-    free(escaped);
+    free(keys);
+    free(vals);
 }
 
-void lval_print_func(lenv *e, lval *v)
+// Same escapes as mpcf_escape, NULL for characters printed as is
+static const char *lval_str_escape(char c)
 {
-    // Returns symbol or error
-    lval *tmp = lenv_get_key(e, v);
-    lval_print(e, tmp);
-    lval_del(tmp);
+    switch (c)
+    {
+    case '\a':
+        return "\\a";
+    case '\b':
+        return "\\b";
+    case '\f':
+        return "\\f";
+    case '\n':
+        return "\\n";
+    case '\r':
+        return "\\r";
+    case '\t':
+        return "\\t";
+    case '\v':
+        return "\\v";
+    case '\\':
+        return "\\\\";
+    case '\'':
+        return "\\'";
+    case '\"':
+        return "\\\"";
+    default:
+        return NULL;
+    }
 }
 
-void lval_print(lenv *e, lval *v)
+void lval_print_str(lbuf *b, lenv *e, lval *v)
+{
+    // Copy runs of plain characters at once, escaping in place
+    const char *s = v->str;
+    const char *run = s;
+
+    lbuf_putc(b, '"');
+    for (; *s; s++)
+    {
+        const char *esc = lval_str_escape(*s);
+        if (!esc)
+            continue;
+
+        lbuf_write(b, run, s - run);
+        lbuf_write(b, esc, 2);
+        run = s + 1;
+    }
+    lbuf_write(b, run, s - run);
+    lbuf_putc(b, '"');
+}
+
+void lval_print_func(lbuf *b, lenv *e, lval *v)
+{
+    lbuf_puts(b, v->builtin->name);
+}
+
+void lval_write(lbuf *b, lenv *e, lval *v)
 {
     switch (v->type)
     {
     case LVAL_NUM:
-        printf("%ld", v->num);
+        if (v->big)
+            lbig_write(b, v->big);
+        else
+            lbuf_long(b, v->num);
+        break;
+    case LVAL_DOUBLE:
+        lbuf_double(b, v->dbl);
         break;
     case LVAL_BOOL:
-        printf("%s", v->bool ? "true" : "false");
+        lbuf_puts(b, v->bool ? "true" : "false");
         break;
     case LVAL_STR:
-        lval_print_str(e, v);
+        lval_print_str(b, e, v);
         break;
     case LVAL_ERR:
-        printf("Error: %s", v->err);
+        lbuf_puts(b, "Error: ");
+        lbuf_puts(b, v->err);
         break;
     case LVAL_SYM:
-        printf("%s", v->sym);
+        lbuf_puts(b, v->sym);
         break;
     case LVAL_FUN:
         if (v->builtin)
-            lval_print_func(e, v);
+            lval_print_func(b, e, v);
         else
         {
-            printf("(\\ ");
-            lval_print(e, v->formals);
-            putchar(' ');
-            lval_print(e, v->body);
-            putchar(')');
+            lbuf_puts(b, "(\\ ");
+            lval_write(b, e, v->lambda->formals);
+            lbuf_putc(b, ' ');
+            lval_write(b, e, v->lambda->body);
+            lbuf_putc(b, ')');
         }
         break;
     case LVAL_SEXPR:
-        lval_expr_print(e, v, '(', ')');
+        lval_expr_print(b, e, v, '(', ')');
         break;
     case LVAL_QEXPR:
-        lval_expr_print(e, v, '{', '}');
+        lval_expr_print(b, e, v, '{', '}');
+        break;
+    case LVAL_MAP:
+        lval_map_print(b, e, v);
         break;
     default:
-        printf("UNEXPECTED ERROR");
+        lbuf_puts(b, "UNEXPECTED ERROR");
         break;
     }
 }
 
+char *lval_to_str(lenv *e, lval *v)
+{
+    lbuf *b = lbuf_new(NULL);
+    lval_write(b, e, v);
+    char *s = lbuf_take(b);
+    lbuf_del(b);
+
+    return s;
+}
+
+void lval_print(lenv *e, lval *v)
+{
+    lbuf *b = lval_get_output();
+    lval_write(b, e, v);
+    lbuf_flush(b);
+}
+
 void lval_println(lenv *e, lval *v)
 {
-    lval_print(e, v);
-    putchar('\n');
+    lbuf *b = lval_get_output();
+    lval_write(b, e, v);
+    lbuf_putc(b, '\n');
+    lbuf_flush(b);
 }
 
 /* --------------------------- */
 /* ---------- EVAL  ---------- */
 /* --------------------------- */
 
+/* Builtin bound to HEAD, when HEAD is a symbol, NULL otherwise
+Called through its pointer the function needs no copy. Evaluating the
+arguments may rebind HEAD, but builtins are only ever replaced, the pointer
+taken first stays good */
+static lval *lval_head_builtin(lenv *e, lval *head)
+{
+    lval *f = head->type == LVAL_SYM ? lenv_find(e, head) : NULL;
+    return f && f->type == LVAL_FUN && f->builtin ? f : NULL;
+}
+
+/* Call builtin B on the evaluated arguments A, unless one of them is an
+error or they do not fit its signature */
+static lval *lval_call_builtin(lenv *e, const lbuiltin_info *b, lval *a)
+{
+    for (size_t i = 0; i < a->count; i++)
+        if (a->cell[i]->type == LVAL_ERR)
+            return lval_take(a, i);
+
+    prof_push(b->name);
+    lval *r = lbuiltin_check(b, a);
+    if (!r)
+        r = b->func(e, a);
+    prof_pop();
+
+    return r;
+}
+
 lval *lval_eval_sexpr(lenv *e, lval *v)
 {
+    if (v->folded && lval_fold_holds(e, v))
+    {
+        lval *x = v->folded;
+        v->folded = NULL;
+        lval_del(v);
+        return x;
+    }
+    // Evaluated as written, V may become the arguments of the call
+    if (v->folded)
+    {
+        lval_del(v->folded);
+        v->folded = NULL;
+    }
+
+    lval *f = v->count > 1 ? lval_head_builtin(e, v->cell[0]) : NULL;
+    lval *next = NULL;
+    lval *r = f && f->builtin->form ? f->builtin->form(e, f->builtin, v, &next)
+                                    : NULL;
+    if (next)
+        r = lval_eval_list(e, next);
+    if (r)
+    {
+        lval_del(v);
+        return r;
+    }
+    if (f)
+    {
+        const lbuiltin_info *b = f->builtin;
+        lval_del(lval_pop(v, 0));
+        for (size_t i = 0; i < v->count; i++)
+            v->cell[i] = lval_eval(e, v->cell[i]);
+        return lval_call_builtin(e, b, v);
+    }
+
     // Evaluale children
     for (size_t i = 0; i < v->count; i++)
         v->cell[i] = lval_eval(e, v->cell[i]);
 
+    return lval_apply(e, v);
+}
+
+// Evaluated copy of X, an element of code run by lval_eval_list
+static lval *lval_eval_kept(lenv *e, lval *x)
+{
+    if (x->type == LVAL_SYM)
+        return lenv_get(e, x);
+    if (x->type == LVAL_SEXPR && x->folded && lval_fold_holds(e, x))
+        return lval_copy(x->folded);
+    if (x->type == LVAL_SEXPR)
+        return lval_eval_list(e, x);
+
+    return lval_copy(x);
+}
+
+lval *lval_eval_list(lenv *e, lval *v)
+{
+    lcursor c;
+    lval *head;
+    lval *f;
+    for (;;)
+    {
+        c = lcursor_of(v);
+        head = v->count > 1 ? lcursor_next(&c) : NULL;
+        f = head ? lval_head_builtin(e, head) : NULL;
+        if (!f || !f->builtin->form)
+            break;
+
+        lval *next = NULL;
+        lval *r = f->builtin->form(e, f->builtin, v, &next);
+        if (r)
+            return r;
+        if (!next)
+            break;
+        // Forms in tail position go on with the code they picked
+        v = next;
+    }
+
+    lval *x = lval_sexpr();
+    lval_reserve(x, 0, v->count);
+    if (f)
+    {
+        const lbuiltin_info *b = f->builtin;
+        while (x->count < v->count - 1)
+            x->cell[x->count++] = lval_eval_kept(e, lcursor_next(&c));
+        return lval_call_builtin(e, b, x);
+    }
+    if (head)
+        x->cell[x->count++] = lval_eval_kept(e, head);
+
+    // Evaluate copies of the children, nested S-Expressions in place too
+    while (x->count < v->count)
+        x->cell[x->count++] = lval_eval_kept(e, lcursor_next(&c));
+
+    return lval_apply(e, x);
+}
+
+lval *form_if(lenv *e, const lbuiltin_info *b, lval *x, lval **next)
+{
+    // Branches computed at run time are left to the call
+    lval *then = x->count == 4 ? lval_nth(x, 2) : NULL;
+    lval *other = then ? lval_nth(x, 3) : NULL;
+    if (!then || then->type != LVAL_QEXPR || other->type != LVAL_QEXPR)
+        return NULL;
+
+    lval *cond = lval_eval_kept(e, lval_nth(x, 1));
+    if (cond->type != LVAL_BOOL)
+    {
+        // The error the call would have raised
+        lval *a = lval_add(lval_sexpr(), cond);
+        lval_add(a, lval_copy(then));
+        lval_add(a, lval_copy(other));
+        return lval_call_builtin(e, b, a);
+    }
+
+    *next = cond->bool ? then : other;
+    lval_del(cond);
+
+    return NULL;
+}
+
+/* && and || as forms on X, known once the first operand is DECIDER
+The second is only evaluated otherwise, to be called with the first */
+static lval *lval_form_logic(lenv *e, const lbuiltin_info *b, lval *x,
+                             bool decider)
+{
+    if (x->count != 3)
+        return NULL;
+
+    lval *first = lval_eval_kept(e, lval_nth(x, 1));
+    if (first->type == LVAL_BOOL && first->bool == decider)
+        return first;
+
+    lval *a = lval_add(lval_sexpr(), first);
+    lval_add(a, lval_eval_kept(e, lval_nth(x, 2)));
+
+    return lval_call_builtin(e, b, a);
+}
+
+lval *form_and(lenv *e, const lbuiltin_info *b, lval *x, lval **next)
+{
+    return lval_form_logic(e, b, x, false);
+}
+
+lval *form_or(lenv *e, const lbuiltin_info *b, lval *x, lval **next)
+{
+    return lval_form_logic(e, b, x, true);
+}
+
+lval *lval_apply(lenv *e, lval *v)
+{
     // Error checking
     for (size_t i = 0; i < v->count; i++)
         if (v->cell[i]->type == LVAL_ERR)
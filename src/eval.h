@@ -1,11 +1,13 @@
 #ifndef eval_h
-#define evan_h
+#define eval_h
 
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "buffer.h"
 #include "mpc.h"
 
 // Main error handling pre-processor expansion
@@ -31,9 +33,13 @@
             func, index + 1, ltype_name(args->cell[index]->type),              \
             ltype_name(expect));
 
-// Expansion for assuring operating on non-empty list
+/* Expansion for assuring operating on non-empty list
+Only lists have a count, any other type is reported as empty */
 #define LASSERT_NON_EMPTY(func, args, index)                                   \
-    LASSERT(args, args->cell[index]->count != 0,                               \
+    LASSERT(args,                                                              \
+            (args->cell[index]->type == LVAL_SEXPR ||                          \
+             args->cell[index]->type == LVAL_QEXPR) &&                         \
+                args->cell[index]->count != 0,                                 \
             "Function %s expects non-empty list for argument %d", func,        \
             index);
 
@@ -48,8 +54,17 @@ enum
     LVAL_FUN,
     LVAL_SEXPR,
     LVAL_QEXPR,
+    LVAL_MAP,
+    LVAL_DOUBLE,
+    // Number of types, keep last
+    LVAL_TYPE_COUNT,
 };
 
+/* lval [depth] of symbols found in the global environment, and of symbols
+not looked up yet. Others count the environments up from the evaluating one */
+#define LSYM_GLOBAL -1
+#define LSYM_UNRESOLVED -2
+
 typedef enum
 {
     false,
@@ -57,28 +72,155 @@ typedef enum
 } bool;
 typedef struct lval lval;
 typedef struct lenv lenv;
+typedef struct lvec lvec;
+typedef struct lpair lpair;
+typedef struct lmap lmap;
+typedef struct lbig lbig;
+typedef struct lmemo lmemo;
+typedef struct llambda llambda;
 typedef lval *(*lbuiltin)(lenv *, lval *);
+typedef struct lbuiltin_info lbuiltin_info;
+typedef lval *(*lform)(lenv *, const lbuiltin_info *, lval *, lval **);
 
 struct lval
 {
     int type;
-    bool bool;
-    long num;
-    char *str;
-    char *err;
-    char *sym;
-
-    /* Pointer to a function in the context
-    If NULL, it is user-defined function, builtin otherwise */
-    lbuiltin builtin;
+    // Type at construction, memory accounting ignores later conversions
+    int origin;
+
+    /* Fields of each type, sharing their storage with those of the others
+    Only S-Expressions and Q-Expressions change type in place, between each
+    other, so nothing else is read under a type it was not built with */
+    union
+    {
+        bool bool;
+        struct
+        {
+            long num;
+            /* Numbers past a long, see bignum.h, shared between copies. NUM
+            then holds LONG_MAX or LONG_MIN by their sign, NULL whenever the
+            value fits */
+            lbig *big;
+        };
+        double dbl;
+        char *str;
+        char *err;
+        struct
+        {
+            /* Interned by lval_intern, shared between copies and compared by
+            address. DEPTH and SLOT tell where it was last found, see
+            lenv_get. Global slots hold while the global environment is at
+            VERSION */
+            const char *sym;
+            int depth;
+            int slot;
+            unsigned long version;
+        };
+
+        struct
+        {
+            /* Registry entry of a builtin, see lbuiltin_info
+            If NULL, it is user-defined function, builtin otherwise */
+            const lbuiltin_info *builtin;
+            /* Name a function was registered or defined under, NULL if
+            anonymous. Interned by lval_intern, shared between copies */
+            const char *name;
+            // Parameters and body of a lambda, shared between copies
+            llambda *lambda;
+            /* Result cache of a lambda wrapped by memo, see memo.h, shared
+            between copies. BOUND holds the arguments partial applications
+            have bound since, the prefix of the cache key, NULL when none */
+            lmemo *memo;
+            lval *bound;
+        };
+
+        struct
+        {
+            // Number of lists within cell field
+            int count;
+            /* Allocation CELL points into, holding CAP pointers
+            Free slots on both sides make popping and pushing at either end
+            cheap */
+            int cap;
+            // List of pointers to other lval pointers
+            struct lval **cell;
+            struct lval **block;
+            /* Long Q-Expressions shared between copies, see vector.h
+            When set the elements live here and CELL is NULL, COUNT still
+            holds their number */
+            lvec *vec;
+            /* Lists grown by cons, linked from the front, see lpair
+            When set the elements live here and CELL is NULL */
+            lpair *pair;
+            /* Value of an S-Expression calling a pure builtin on constants,
+            worked out when the lambda holding it was defined, NULL if not
+            folded. Only used while the heads of the calls still name those
+            builtins */
+            lval *folded;
+        };
+        // Entries of a map, see map.h, NULL when empty
+        lmap *map;
+    };
+};
+
+/* Link of a list built by cons, shared between copies by reference count
+HEAD and the reference to TAIL are owned, links are never changed while
+shared, so every list consed onto the same tail keeps pointing at it */
+struct lpair
+{
+    int refs;
+    lval *head;
+    // NULL on the last link
+    lpair *tail;
+    // List hash of the chain from this link on, see LHASH_FACTOR
+    bool hashed;
+    unsigned long hash;
+};
+
+/* Parameters, body and arguments already bound of a lambda
+Shared by reference count and never changed, partial application builds a
+new one. FORMALS are kept in cells, ENV is NULL until some are bound */
+struct llambda
+{
+    int refs;
     lenv *env;
     lval *formals;
     lval *body;
+};
 
-    // Number of lists within cell field
-    int count;
-    // List of pointers to other lval pointers
-    struct lval **cell;
+// Flags of a builtin in the registry
+enum
+{
+    // Result depends on the arguments alone, calling it has no other effect
+    LBUILTIN_PURE = 1
+};
+
+// Upper bound of MAX for builtins taking any number of arguments
+#define LBUILTIN_VARIADIC -1
+
+/* Builtin as lenv_add_builtins registers it, every copy of its function
+points here
+SIG lists the accepted arguments a character each: 'n' Number or Double,
+'b' Boolean, 's' String, 'q' Q-Expression, 'Q' non-empty Q-Expression, 'f'
+Function, 'm' Map or '.' any type. A '|' marks the ones after it optional, a
+trailing '*' repeats the last one any number of times. MIN and MAX are filled
+in from it on registration. Calls are checked against it before FUNC runs,
+which can rely on the types it asks for. Only fixed arities are checked
+there, FUNC counts its arguments itself when some are optional */
+struct lbuiltin_info
+{
+    const char *name;
+    lbuiltin func;
+    const char *sig;
+    int flags;
+    /* Special form run on the whole unevaluated expression instead, NULL if
+    none. Operands are evaluated only as it needs them, the expression is
+    left untouched. Returns NULL, before evaluating anything, for calls it
+    leaves to FUNC. Returns NULL too after storing in its last argument the
+    part of the expression to evaluate in its place */
+    lform form;
+    int min;
+    int max;
 };
 
 struct lenv
@@ -86,14 +228,28 @@ struct lenv
     /* Pointer to parent environment
     If NULL, then the current environment is the global one */
     lenv *parent;
-    // Double list of matching lengths
+    /* Set on per-session environments
+    def stops here instead of climbing up to the shared global one */
+    bool root;
+    // Double list of matching lengths, with room for CAP entries
     int count;
-    // Stores keys
-    char **syms;
+    int cap;
+    /* Set when SYMS and VALS are not owned, as for call frames
+    They are moved to the heap once more room is needed */
+    bool borrowed;
+    // Stores keys, interned by lval_intern
+    const char **syms;
     // Stores values
     lval **vals;
 };
 
+// Bindings an activation frame holds before moving them to the heap
+#define LFRAME_SLOTS 4
+
+/* Bits a product or power may reach and still be folded into a lambda when
+it is defined, larger ones are left to the calls that need them */
+#define LFOLD_BITS 4096
+
 /* --------------------------------------- */
 /* ---------- LENV DECLARATIONS ---------- */
 /* --------------------------------------- */
@@ -105,12 +261,11 @@ lenv *lenv_new(void);
 void lenv_del(lenv *e);
 
 /* Attempt to find value of V inside environment E
-Return value if found, return error otherwise */
+Return value if found, return error otherwise. Where V was resolved is only
+a hint, checked against E before use, the search of every parent stays the
+fallback */
 lval *lenv_get(lenv *e, lval *v);
 
-/* Reverse look up lenv_get */
-lval *lenv_get_key(lenv *e, lval *k);
-
 /* Return deep copy of environment E */
 lenv *lenv_copy(lenv *e);
 
@@ -124,10 +279,12 @@ int lenv_put(lenv *e, lval *k, lval *v);
 // Call LENV_PUT on global environment E
 int lenv_def(lenv *e, lval *k, lval *v);
 
-/* Bind key ID to function FUNC */
-void lenv_add_builtin(lenv *e, char *id, lbuiltin func);
+/* Bind the name of registry entry B to its function
+Fills in the arity of B from its signature */
+void lenv_add_builtin(lenv *e, lbuiltin_info *b);
 
-/* Group adding builtin functions */
+/* Group adding every builtin of the registry
+E becomes the global environment symbols are resolved against */
 void lenv_add_builtins(lenv *e);
 
 /* --------------------------------------- */
@@ -135,45 +292,77 @@ void lenv_add_builtins(lenv *e);
 /* --------------------------------------- */
 
 // Construct pointers to types of lval
-lval *lval_empty(void);
+lval *lval_empty(int type);
 lval *lval_num(long num);
+// Number holding A, a fixnum whenever it fits a long, takes the reference
+lval *lval_big(lbig *a);
+lval *lval_double(double dbl);
 lval *lval_bool(bool bool);
 lval *lval_str(char *str);
 lval *lval_err(char *fmt, ...);
-lval *lval_sym(char *symbol);
-lval *lval_fun(lbuiltin func);
+lval *lval_sym(const char *symbol);
+lval *lval_fun(const lbuiltin_info *builtin);
 lval *lval_lambda(lval *formals, lval *body);
 lval *lval_sexpr(void);
 lval *lval_qexpr(void);
+lval *lval_map(void);
+
+/* Return a copy of S that lives until exit
+Equal strings share one copy */
+const char *lval_intern(const char *s);
 
 // Deconstruct lval pointers
 void lval_del(lval *v);
 
 // Parsing lval
+int lval_read_ignored(mpc_ast_t *t);
 lval *lval_read_num(mpc_ast_t *t);
 lval *lval_read_str(mpc_ast_t *t);
 lval *lval_read(mpc_ast_t *t);
 lval *lval_add(lval *v, lval *x);
 
-// Print lval
-void lval_expr_print(lenv *e, lval *v, char open, char close);
-void lval_print_str(lenv *e, lval *v);
-void lval_print_func(lenv *e, lval *v);
+// Serialize lval into buffer B
+void lval_expr_print(lbuf *b, lenv *e, lval *v, char open, char close);
+void lval_map_print(lbuf *b, lenv *e, lval *v);
+void lval_print_str(lbuf *b, lenv *e, lval *v);
+void lval_print_func(lbuf *b, lenv *e, lval *v);
+void lval_write(lbuf *b, lenv *e, lval *v);
+
+/* Return V printed into a new string owned by the caller */
+char *lval_to_str(lenv *e, lval *v);
+
+// Print lval to the output buffer and flush it
 void lval_print(lenv *e, lval *v);
 void lval_println(lenv *e, lval *v);
 char *ltype_name(int t);
 
+/* Redirect everything printed by lval_print and builtin_print to B
+Defaults to a buffer flushing to stdout */
+void lval_set_output(lbuf *b);
+lbuf *lval_get_output(void);
+
 /* Remove element I from V
-Shift remaining list towards the removed element's position */
+Shift whichever side of the list is shorter over the removed position */
 lval *lval_pop(lval *v, int i);
 
 /* Push X to the front of V
-Shifts entire list forward one position */
+Q-Expressions are turned into linked pairs, unless already a vector */
 lval *lval_push(lval *v, lval *x);
 
-/* Return deep copy of V*/
+/* Return deep copy of V
+Long Q-Expressions are moved into a vector first and then shared, linked
+pairs are always shared */
 lval *lval_copy(lval *v);
 
+/* Element I of V, whether V is stored in cells, as a vector or as pairs */
+lval *lval_nth(lval *v, int i);
+
+/* Move the elements of V back into cells, for code indexing CELL */
+void lval_flatten(lval *v);
+
+/* Keep elements START to END, excluded, of V and delete the others */
+lval *lval_slice(lval *v, int start, int end);
+
 /* Apply LVAL_POP on V in index I
 Delete the remaining of V */
 lval *lval_take(lval *v, int i);
@@ -188,6 +377,20 @@ lval *lval_call(lenv *e, lval *params, lval *args);
 /* Equality check between entirety of X and Y */
 bool lval_eq(lval *x, lval *y);
 
+/* Hash of V, equal for any two values LVAL_EQ finds equal
+Lists hash the same whatever their layout, maps whatever their order.
+Vectors, pairs and maps keep the hashes of their parts, which never change */
+unsigned long lval_hash(lval *v);
+
+/* Lists hash as the sum of their element hashes, element I weighted by
+this odd factor to the power I. A list made of parts is then hashed from
+the hashes of the parts, the second weighted by the factor to the length
+of the first */
+#define LHASH_FACTOR 0x9e3779b97f4a7c15UL
+
+/* Spread the bits of H, for hashes built out of other hashes */
+unsigned long lhash_mix(unsigned long h);
+
 /* --------------------------------------------------------- */
 /* ---------- List Manipulation Builtin Functions ---------- */
 /* --------------------------------------------------------- */
@@ -244,6 +447,32 @@ lval *builtin_print(lenv *e, lval *v);
 /* Display string as an error */
 lval *builtin_error(lenv *e, lval *v);
 
+/* ------------------------------------------- */
+/* ---------- Map Builtin Functions ---------- */
+/* ------------------------------------------- */
+
+/* Return a map of the keys and values alternating in a Q-Expression */
+lval *builtin_map_new(lenv *e, lval *v);
+
+/* Return the value under a key of a map
+An optional third argument is returned when the key is missing */
+lval *builtin_map_get(lenv *e, lval *v);
+
+/* Return the map with a key bound to a value */
+lval *builtin_map_put(lenv *e, lval *v);
+
+/* Return the map without a key */
+lval *builtin_map_del(lenv *e, lval *v);
+
+/* Return the keys of a map as a Q-Expression */
+lval *builtin_map_keys(lenv *e, lval *v);
+
+/* Return the number of entries in a map */
+lval *builtin_map_len(lenv *e, lval *v);
+
+/* Return the hash of any value, equal values hash the same */
+lval *builtin_hash(lenv *e, lval *v);
+
 /* ---------------------------------------------------------- */
 /* ---------- Arithmetic & Logic Builtin Functions ---------- */
 /* ---------------------------------------------------------- */
@@ -274,7 +503,21 @@ lval *builtin_and(lenv *e, lval *v);
 lval *builtin_or(lenv *e, lval *v);
 lval *builtin_not(lenv *e, lval *v);
 
+/* Special forms of if, && and || on the expression X, see lbuiltin_info
+if picks the branch to evaluate in place as NEXT, && and || skip their
+second operand once the first decides the result */
+lval *form_if(lenv *e, const lbuiltin_info *b, lval *x, lval **next);
+lval *form_and(lenv *e, const lbuiltin_info *b, lval *x, lval **next);
+lval *form_or(lenv *e, const lbuiltin_info *b, lval *x, lval **next);
+
 lval *lval_eval_sexpr(lenv *e, lval *v);
 lval *lval_eval(lenv *e, lval *v);
 
+/* Evaluate the elements of V as an S-Expression, leaving V untouched
+For code run again and again, like lambda bodies */
+lval *lval_eval_list(lenv *e, lval *v);
+
+/* Call the function heading the evaluated S-Expression V on the rest */
+lval *lval_apply(lenv *e, lval *v);
+
 #endif
@@ -0,0 +1,65 @@
+#include <stdio.h>
+
+#include "grammar.h"
+
+// Forward declare parsers
+static mpc_parser_t *Number;
+static mpc_parser_t *Symbol;
+static mpc_parser_t *String;
+static mpc_parser_t *Comment;
+static mpc_parser_t *Sexpr;
+static mpc_parser_t *Qexpr;
+static mpc_parser_t *Expr;
+static mpc_parser_t *Lispy;
+
+mpc_parser_t *lispy_grammar_new(bool stats)
+{
+    // Defining the Grammar for Lisp-in-C
+    Number = mpc_new("number");
+    Symbol = mpc_new("symbol");
+    String = mpc_new("string");
+    Comment = mpc_new("comment");
+    Sexpr = mpc_new("sexpr");
+    Qexpr = mpc_new("qexpr");
+    Expr = mpc_new("expr");
+    Lispy = mpc_new("lispy");
+
+    // With stats the optimiser only runs below, so both counts are visible
+    mpca_lang(stats ? MPCA_LANG_NO_OPTIMISE : MPCA_LANG_DEFAULT, "                                            \
+        number   : /-?[0-9]+[.]?[0-9]*([eE][-+]?[0-9]+)?/;              \
+        symbol   : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&^%|]+/;                 \
+        string   : /\"(\\\\.|[^\"])*\"/;                                \
+        comment  : /;[^\\r\\n]*/;                                       \
+        sexpr    : '(' <expr>* ')';                                     \
+        qexpr    : '{' <expr>* '}';                                     \
+        expr     : <number> | <symbol> |  <string> | <sexpr> | <qexpr>; \
+        lispy    : /^/ <expr>* /$/;                                     \
+    ",
+              Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy);
+
+    mpc_parser_t *parsers[] = {Number, Symbol, String, Comment,
+                               Sexpr,  Qexpr,  Expr,   Lispy};
+    char *names[] = {"number", "symbol", "string", "comment",
+                     "sexpr",  "qexpr",  "expr",   "lispy"};
+    for (size_t i = 0; i < sizeof(parsers) / sizeof(parsers[0]); i++)
+    {
+        if (stats)
+        {
+            printf("<%s> before optimisation\n", names[i]);
+            mpc_stats(parsers[i]);
+        }
+        mpc_optimise(parsers[i]);
+        if (stats)
+        {
+            printf("<%s> after optimisation\n", names[i]);
+            mpc_stats(parsers[i]);
+        }
+    }
+
+    return Lispy;
+}
+
+void lispy_grammar_delete(void)
+{
+    mpc_cleanup(8, Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy);
+}
@@ -0,0 +1,15 @@
+#ifndef grammar_h
+#define grammar_h
+
+#include <stdbool.h>
+
+#include "mpc.h"
+
+/* Build and optimise the Lispy grammar, returns its top-level parser
+With STATS, node counts of every rule are printed before and after */
+mpc_parser_t *lispy_grammar_new(bool stats);
+
+/* Free every parser built by lispy_grammar_new */
+void lispy_grammar_delete(void);
+
+#endif
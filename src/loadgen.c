@@ -0,0 +1,218 @@
+// getopt and clock_gettime are POSIX, hidden by -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Load generator for parsing --serve
+Keeps CONNS connections busy with one outstanding request each until
+REQUESTS responses arrived, then reports latency percentiles and throughput */
+
+typedef struct
+{
+    int fd;
+    // Send time of the outstanding request
+    double start;
+    // Response bytes received so far
+    char *buf;
+    size_t len;
+    size_t cap;
+} client;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int connect_to(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        buf += n;
+        len -= n;
+    }
+
+    return 1;
+}
+
+static void usage(char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-c conns] [-n requests] [-e expr] socket\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int conns = 8;
+    long requests = 10000;
+    char *expr = "(+ 1 2)";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:e:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            conns = atoi(optarg);
+            break;
+        case 'n':
+            requests = atol(optarg);
+            break;
+        case 'e':
+            expr = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || conns <= 0 || requests <= 0)
+        usage(argv[0]);
+
+    // Build the request frame once
+    size_t elen = strlen(expr);
+    char *frame = malloc(elen + 4);
+    uint32_t n = htonl((uint32_t)elen);
+    memcpy(frame, &n, 4);
+    memcpy(frame + 4, expr, elen);
+
+    if (conns > requests)
+        conns = requests;
+
+    client *cs = calloc(conns, sizeof(client));
+    struct pollfd *pfds = calloc(conns, sizeof(struct pollfd));
+    double *lat = malloc(sizeof(double) * requests);
+    long sent = 0, done = 0, errors = 0;
+
+    double begin = now();
+    for (size_t i = 0; i < conns; i++)
+    {
+        cs[i].fd = connect_to(argv[optind]);
+        if (cs[i].fd < 0)
+            return 1;
+        pfds[i].fd = cs[i].fd;
+        pfds[i].events = POLLIN;
+
+        cs[i].start = now();
+        send_all(cs[i].fd, frame, elen + 4);
+        sent++;
+    }
+
+    while (done < requests)
+    {
+        if (poll(pfds, conns, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return 1;
+        }
+
+        for (size_t i = 0; i < conns; i++)
+        {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            client *c = &cs[i];
+            if (c->cap - c->len < 4096)
+            {
+                c->cap = c->cap ? c->cap * 2 : 8192;
+                c->buf = realloc(c->buf, c->cap);
+            }
+
+            ssize_t r = read(c->fd, c->buf + c->len, c->cap - c->len);
+            if (r <= 0)
+            {
+                fprintf(stderr, "Server closed connection %zu\n", i);
+                return 1;
+            }
+            c->len += r;
+
+            // Wait for the whole response frame
+            if (c->len < 4)
+                continue;
+            uint32_t size;
+            memcpy(&size, c->buf, 4);
+            size = ntohl(size);
+            if (c->len < 4 + size)
+                continue;
+
+            lat[done++] = now() - c->start;
+            if (size == 0 || c->buf[4] != 0)
+                errors++;
+            c->len = 0;
+
+            if (sent < requests)
+            {
+                c->start = now();
+                send_all(c->fd, frame, elen + 4);
+                sent++;
+            }
+        }
+    }
+    double elapsed = now() - begin;
+
+    qsort(lat, requests, sizeof(double), cmp_double);
+    printf("requests: %ld\n", requests);
+    printf("connections: %d\n", conns);
+    printf("errors: %ld\n", errors);
+    printf("rps: %.0f\n", requests / elapsed);
+    printf("p50: %.1f us\n", lat[(requests - 1) / 2] * 1e6);
+    printf("p99: %.1f us\n", lat[(requests - 1) * 99 / 100] * 1e6);
+    printf("max: %.1f us\n", lat[requests - 1] * 1e6);
+
+    for (size_t i = 0; i < conns; i++)
+    {
+        close(cs[i].fd);
+        free(cs[i].buf);
+    }
+    free(cs);
+    free(pfds);
+    free(lat);
+    free(frame);
+
+    return 0;
+}
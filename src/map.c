@@ -0,0 +1,312 @@
+#include "map.h"
+#include "memstats.h"
+
+static int lmap_popcount(unsigned int x)
+{
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+static void lmap_entry_del(lmap_entry *x)
+{
+    if (--x->refs)
+        return;
+
+    lval_del(x->key);
+    lval_del(x->val);
+    free(x);
+}
+
+static void lmap_slot_ref(lmap_slot *s)
+{
+    if (s->kid)
+        lmap_ref(s->kid);
+    else
+        s->entry->refs++;
+}
+
+// Bit of the slot HASH selects on the level at SHIFT
+static unsigned int lmap_bit(unsigned long hash, int shift)
+{
+    return 1u << ((hash >> shift) & (LMAP_WIDTH - 1));
+}
+
+// Position of the slot for BIT among those N uses
+static int lmap_index(lmap *n, unsigned int bit)
+{
+    return lmap_popcount(n->bitmap & (bit - 1));
+}
+
+/* Copy of N with DROP slots removed from I on and S, unless NULL, put there
+N may be NULL for an empty node. Kept slots get a new reference, S is moved
+into the copy */
+static lmap *lmap_splice(lmap *n, unsigned int bitmap, int i, int drop,
+                         lmap_slot *s)
+{
+    int count = (n ? n->count : 0) - drop + (s != NULL);
+    lmap *c = malloc(sizeof(lmap) + sizeof(lmap_slot) * count);
+    mem_shared(LVAL_MAP, sizeof(lmap) + sizeof(lmap_slot) * count);
+    c->refs = 1;
+    c->bitmap = bitmap;
+    c->size = 0;
+    c->count = 0;
+    c->hashed = false;
+
+    for (int j = 0; j < i; j++)
+    {
+        c->slot[c->count] = n->slot[j];
+        lmap_slot_ref(&c->slot[c->count++]);
+    }
+    if (s)
+        c->slot[c->count++] = *s;
+    for (int j = i + drop; n && j < n->count; j++)
+    {
+        c->slot[c->count] = n->slot[j];
+        lmap_slot_ref(&c->slot[c->count++]);
+    }
+
+    for (int j = 0; j < c->count; j++)
+        c->size += c->slot[j].kid ? c->slot[j].kid->size : 1;
+
+    return c;
+}
+
+lmap *lmap_ref(lmap *m)
+{
+    m->refs++;
+    return m;
+}
+
+void lmap_del(lmap *m)
+{
+    if (!m || --m->refs)
+        return;
+
+    for (int i = 0; i < m->count; i++)
+    {
+        if (m->slot[i].kid)
+            lmap_del(m->slot[i].kid);
+        else
+            lmap_entry_del(m->slot[i].entry);
+    }
+    free(m);
+}
+
+size_t lmap_size(lmap *m)
+{
+    return m ? m->size : 0;
+}
+
+static bool lmap_match(lmap_entry *x, unsigned long hash, lval *key)
+{
+    return x->hash == hash && lval_eq(x->key, key);
+}
+
+static lval *lmap_find(lmap *m, unsigned long hash, lval *key)
+{
+    for (int shift = 0; m; shift += LMAP_BITS)
+    {
+        // Past the hash every entry of the node is a candidate
+        if (shift >= LMAP_HASH_BITS)
+        {
+            for (int i = 0; i < m->count; i++)
+                if (lmap_match(m->slot[i].entry, hash, key))
+                    return m->slot[i].entry->val;
+            return NULL;
+        }
+
+        unsigned int bit = lmap_bit(hash, shift);
+        if (!(m->bitmap & bit))
+            return NULL;
+
+        lmap_slot *s = &m->slot[lmap_index(m, bit)];
+        if (!s->kid)
+            return lmap_match(s->entry, hash, key) ? s->entry->val : NULL;
+        m = s->kid;
+    }
+
+    return NULL;
+}
+
+lval *lmap_get(lmap *m, lval *key)
+{
+    return lmap_find(m, lval_hash(key), key);
+}
+
+/* N with entry X added below the level at SHIFT, replacing an equal key
+N may be NULL and keeps its reference, X is moved into the result */
+static lmap *lmap_assoc(lmap *n, int shift, lmap_entry *x)
+{
+    lmap_slot s = {x, NULL};
+
+    if (shift >= LMAP_HASH_BITS)
+    {
+        for (int i = 0; n && i < n->count; i++)
+            if (lval_eq(n->slot[i].entry->key, x->key))
+                return lmap_splice(n, 0, i, 1, &s);
+        return lmap_splice(n, 0, n ? n->count : 0, 0, &s);
+    }
+
+    unsigned int bit = lmap_bit(x->hash, shift);
+    if (!n || !(n->bitmap & bit))
+        return lmap_splice(n, (n ? n->bitmap : 0) | bit,
+                           n ? lmap_index(n, bit) : 0, 0, &s);
+
+    int i = lmap_index(n, bit);
+    lmap_slot *old = &n->slot[i];
+    if (old->kid)
+        s = (lmap_slot){NULL, lmap_assoc(old->kid, shift + LMAP_BITS, x)};
+    else if (!lmap_match(old->entry, x->hash, x->key))
+    {
+        // Both entries move one level down, where their hashes may differ
+        old->entry->refs++;
+        lmap *kid = lmap_assoc(NULL, shift + LMAP_BITS, old->entry);
+        s = (lmap_slot){NULL, lmap_assoc(kid, shift + LMAP_BITS, x)};
+        lmap_del(kid);
+    }
+
+    return lmap_splice(n, n->bitmap, i, 1, &s);
+}
+
+lmap *lmap_put(lmap *m, lval *key, lval *val)
+{
+    lmap_entry *x = malloc(sizeof(lmap_entry));
+    mem_shared(LVAL_MAP, sizeof(lmap_entry));
+    x->refs = 1;
+    x->hash = lval_hash(key);
+    x->key = key;
+    x->val = val;
+
+    return lmap_assoc(m, 0, x);
+}
+
+/* N without KEY below the level at SHIFT, NULL when it is left empty
+N itself with a new reference when KEY is missing */
+static lmap *lmap_dissoc(lmap *n, int shift, unsigned long hash, lval *key)
+{
+    if (shift >= LMAP_HASH_BITS)
+    {
+        for (int i = 0; i < n->count; i++)
+            if (lmap_match(n->slot[i].entry, hash, key))
+                return n->count > 1 ? lmap_splice(n, 0, i, 1, NULL) : NULL;
+        return lmap_ref(n);
+    }
+
+    unsigned int bit = lmap_bit(hash, shift);
+    if (!(n->bitmap & bit))
+        return lmap_ref(n);
+
+    int i = lmap_index(n, bit);
+    lmap_slot *old = &n->slot[i];
+    if (!old->kid)
+    {
+        if (!lmap_match(old->entry, hash, key))
+            return lmap_ref(n);
+        return n->count > 1 ? lmap_splice(n, n->bitmap & ~bit, i, 1, NULL)
+                            : NULL;
+    }
+
+    lmap *kid = lmap_dissoc(old->kid, shift + LMAP_BITS, hash, key);
+    if (kid == old->kid)
+    {
+        lmap_del(kid);
+        return lmap_ref(n);
+    }
+    if (!kid)
+        return n->count > 1 ? lmap_splice(n, n->bitmap & ~bit, i, 1, NULL)
+                            : NULL;
+
+    // A child left with a lone entry is replaced by it
+    lmap_slot s = {NULL, kid};
+    if (kid->count == 1 && !kid->slot[0].kid)
+    {
+        s = kid->slot[0];
+        s.entry->refs++;
+        lmap_del(kid);
+    }
+
+    return lmap_splice(n, n->bitmap, i, 1, &s);
+}
+
+lmap *lmap_remove(lmap *m, lval *key)
+{
+    if (!m)
+        return NULL;
+
+    return lmap_dissoc(m, 0, lval_hash(key), key);
+}
+
+unsigned long lmap_hash(lmap *m)
+{
+    if (!m || m->hashed)
+        return m ? m->hash : 0;
+
+    unsigned long hash = 0;
+    for (int i = 0; i < m->count; i++)
+    {
+        lmap_entry *x = m->slot[i].entry;
+        if (m->slot[i].kid)
+            hash += lmap_hash(m->slot[i].kid);
+        else
+            hash += lhash_mix(x->hash ^ lval_hash(x->val) * LHASH_FACTOR);
+    }
+
+    m->hash = hash;
+    m->hashed = true;
+
+    return hash;
+}
+
+// Every entry below A found with an equal value in B
+static bool lmap_within(lmap *a, lmap *b)
+{
+    for (int i = 0; i < a->count; i++)
+    {
+        lmap_slot *s = &a->slot[i];
+        if (s->kid && !lmap_within(s->kid, b))
+            return false;
+        if (s->kid)
+            continue;
+
+        lval *val = lmap_find(b, s->entry->hash, s->entry->key);
+        if (!val || !lval_eq(s->entry->val, val))
+            return false;
+    }
+
+    return true;
+}
+
+bool lmap_eq(lmap *a, lmap *b)
+{
+    if (a == b)
+        return true;
+    if (lmap_size(a) != lmap_size(b))
+        return false;
+
+    return lmap_within(a, b);
+}
+
+static void lmap_collect(lmap *m, lval **keys, lval **vals, size_t *n)
+{
+    for (int i = 0; i < m->count; i++)
+    {
+        if (m->slot[i].kid)
+        {
+            lmap_collect(m->slot[i].kid, keys, vals, n);
+            continue;
+        }
+        if (keys)
+            keys[*n] = m->slot[i].entry->key;
+        if (vals)
+            vals[*n] = m->slot[i].entry->val;
+        (*n)++;
+    }
+}
+
+void lmap_entries(lmap *m, lval **keys, lval **vals)
+{
+    size_t n = 0;
+    if (m)
+        lmap_collect(m, keys, vals, &n);
+}
@@ -0,0 +1,81 @@
+#ifndef map_h
+#define map_h
+
+#include "eval.h"
+
+// Hash bits consumed per level, selecting one of LMAP_WIDTH slots
+#define LMAP_BITS 5
+#define LMAP_WIDTH (1 << LMAP_BITS)
+
+// Levels from this shift on have used up the hash
+#define LMAP_HASH_BITS ((int)sizeof(unsigned long) * 8)
+
+/* Key and value of a map, shared between the nodes holding it
+The hash of the key is kept to compare and rehash without walking it */
+typedef struct
+{
+    int refs;
+    unsigned long hash;
+    lval *key;
+    lval *val;
+} lmap_entry;
+
+// Either an entry or a child node
+typedef struct
+{
+    lmap_entry *entry;
+    lmap *kid;
+} lmap_slot;
+
+/* Node of a persistent hash array mapped trie
+Each level picks a slot from the next LMAP_BITS of the key hash. BITMAP marks
+the slots in use and only those are stored, in bit order, so a node is sized
+to its COUNT. Nodes are never changed once built, a put or remove copies each
+node from the root down to the slot it changes, with that slot added,
+replaced or dropped, and shares every other child. Keys whose whole hashes
+are equal end up side by side in one node past LMAP_HASH_BITS */
+struct lmap
+{
+    int refs;
+    unsigned int bitmap;
+    // Entries below this node
+    size_t size;
+    // Slots in use
+    int count;
+    // Sum of the entry hashes below, filled by lmap_hash on first use
+    bool hashed;
+    unsigned long hash;
+    lmap_slot slot[];
+};
+
+/* Share M with one more owner */
+lmap *lmap_ref(lmap *m);
+
+/* Drop a reference, the last one frees M and its entries
+Does nothing on NULL, the empty map */
+void lmap_del(lmap *m);
+
+/* Number of entries in M */
+size_t lmap_size(lmap *m);
+
+/* Value stored under KEY in M, still owned by M
+NULL when KEY is missing */
+lval *lmap_get(lmap *m, lval *key);
+
+/* M with KEY bound to VAL as a new map, taking ownership of both */
+lmap *lmap_put(lmap *m, lval *key, lval *val);
+
+/* M without KEY as a new map, NULL when nothing is left */
+lmap *lmap_remove(lmap *m, lval *key);
+
+/* Hash of the entries of M whatever their order, 0 when empty */
+unsigned long lmap_hash(lmap *m);
+
+/* Whether A and B hold equal values under equal keys */
+bool lmap_eq(lmap *a, lmap *b);
+
+/* Store every key and value of M in KEYS and VALS, still owned by M
+Either may be NULL when not needed */
+void lmap_entries(lmap *m, lval **keys, lval **vals);
+
+#endif
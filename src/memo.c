@@ -0,0 +1,211 @@
+#include "memo.h"
+
+lmemo *lmemo_new(size_t limit)
+{
+    lmemo *m = malloc(sizeof(lmemo));
+    m->refs = 1;
+    m->limit = limit;
+    m->count = 0;
+    m->cap = 16;
+    m->table = calloc(m->cap, sizeof(lmemo_entry *));
+    m->newest = m->oldest = NULL;
+    m->hits = m->misses = 0;
+
+    return m;
+}
+
+lmemo *lmemo_ref(lmemo *m)
+{
+    m->refs++;
+    return m;
+}
+
+static void lmemo_entry_del(lmemo_entry *x)
+{
+    lval_del(x->args);
+    lval_del(x->result);
+    free(x);
+}
+
+void lmemo_del(lmemo *m)
+{
+    if (!m || --m->refs)
+        return;
+
+    while (m->newest)
+    {
+        lmemo_entry *x = m->newest;
+        m->newest = x->older;
+        lmemo_entry_del(x);
+    }
+    free(m->table);
+    free(m);
+}
+
+// Slot holding ARGS, or the empty one ending its probe
+static size_t lmemo_slot(lmemo *m, unsigned long hash, lval *args)
+{
+    size_t i = hash & (m->cap - 1);
+    while (m->table[i] &&
+           !(m->table[i]->hash == hash && lval_eq(m->table[i]->args, args)))
+        i = (i + 1) & (m->cap - 1);
+
+    return i;
+}
+
+static void lmemo_unlink(lmemo *m, lmemo_entry *x)
+{
+    if (x->newer)
+        x->newer->older = x->older;
+    else
+        m->newest = x->older;
+    if (x->older)
+        x->older->newer = x->newer;
+    else
+        m->oldest = x->newer;
+}
+
+static void lmemo_link(lmemo *m, lmemo_entry *x)
+{
+    x->newer = NULL;
+    x->older = m->newest;
+    if (m->newest)
+        m->newest->newer = x;
+    else
+        m->oldest = x;
+    m->newest = x;
+}
+
+/* Empty slot I, moving later entries of its probe back into the gap so no
+lookup stops short of them */
+static void lmemo_unslot(lmemo *m, size_t i)
+{
+    size_t mask = m->cap - 1;
+    m->table[i] = NULL;
+
+    for (size_t j = (i + 1) & mask; m->table[j]; j = (j + 1) & mask)
+    {
+        // Entries whose home is cyclically within (I, J] stay put
+        size_t home = m->table[j]->hash & mask;
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+
+        m->table[i] = m->table[j];
+        m->table[j] = NULL;
+        i = j;
+    }
+}
+
+lval *lmemo_get(lmemo *m, lval *args)
+{
+    size_t i = lmemo_slot(m, lval_hash(args), args);
+    lmemo_entry *x = m->table[i];
+    if (!x)
+    {
+        m->misses++;
+        return NULL;
+    }
+
+    m->hits++;
+    lmemo_unlink(m, x);
+    lmemo_link(m, x);
+
+    return x->result;
+}
+
+void lmemo_put(lmemo *m, lval *args, lval *result)
+{
+    unsigned long hash = lval_hash(args);
+
+    // A result for the same call replaces the one cached
+    lmemo_entry *x = m->table[lmemo_slot(m, hash, args)];
+    if (x)
+    {
+        lval_del(x->result);
+        x->result = result;
+        lval_del(args);
+        return;
+    }
+
+    // Make room by the least recently used result
+    if (m->count >= m->limit)
+    {
+        lmemo_entry *old = m->oldest;
+        size_t i = old->hash & (m->cap - 1);
+        while (m->table[i] != old)
+            i = (i + 1) & (m->cap - 1);
+        lmemo_unslot(m, i);
+        lmemo_unlink(m, old);
+        lmemo_entry_del(old);
+        m->count--;
+    }
+
+    // Keep the table at most half full
+    if ((m->count + 1) * 2 > m->cap)
+    {
+        lmemo_entry **table = m->table;
+        size_t cap = m->cap;
+        m->cap *= 2;
+        m->table = calloc(m->cap, sizeof(lmemo_entry *));
+        for (size_t i = 0; i < cap; i++)
+            if (table[i])
+                m->table[lmemo_slot(m, table[i]->hash, table[i]->args)] =
+                    table[i];
+        free(table);
+    }
+
+    x = malloc(sizeof(lmemo_entry));
+    x->hash = hash;
+    x->args = args;
+    x->result = result;
+    m->table[lmemo_slot(m, hash, args)] = x;
+    lmemo_link(m, x);
+    m->count++;
+}
+
+lval *builtin_memo(lenv *e, lval *v)
+{
+    // Requires a [lambda] and an optional [positive] bound
+    LASSERT(v, v->count == 1 || v->count == 2,
+            "Function memo non compatible arity -- Got %d, Expected 1 or 2",
+            v->count);
+    LASSERT(v, !v->cell[0]->builtin,
+            "Function memo expects a lambda -- Got a builtin");
+
+    long limit = LMEMO_LIMIT;
+    if (v->count == 2)
+    {
+        LASSERT_TYPE("memo", v, 1, LVAL_NUM);
+        limit = v->cell[1]->num;
+        LASSERT(v, limit > 0,
+                "Function memo expects a positive bound -- Got %ld", limit);
+    }
+
+    lval *f = lval_pop(v, 0);
+    lval_del(v);
+
+    // A fresh cache, keyed from the arguments bound from now on
+    lmemo_del(f->memo);
+    f->memo = lmemo_new(limit);
+    if (f->bound)
+        lval_del(f->bound);
+    f->bound = NULL;
+
+    return f;
+}
+
+lval *builtin_memo_stats(lenv *e, lval *v)
+{
+    LASSERT(v, v->cell[0]->memo,
+            "Function memo-stats expects a function made by memo");
+
+    lmemo *m = v->cell[0]->memo;
+    lval *x = lval_qexpr();
+    lval_add(x, lval_num(m->hits));
+    lval_add(x, lval_num(m->misses));
+    lval_add(x, lval_num(m->count));
+    lval_add(x, lval_num(m->limit));
+    lval_del(v);
+
+    return x;
+}
@@ -0,0 +1,63 @@
+#ifndef memo_h
+#define memo_h
+
+#include "eval.h"
+
+// Results a memo cache keeps unless given another bound
+#define LMEMO_LIMIT 4096
+
+typedef struct lmemo_entry lmemo_entry;
+
+/* Arguments of a call and its result, linked from most to least recently
+used */
+struct lmemo_entry
+{
+    unsigned long hash;
+    lval *args;
+    lval *result;
+    lmemo_entry *newer;
+    lmemo_entry *older;
+};
+
+/* Results of a memoised function, shared by every copy of it
+Open addressing on the argument hash with linear probing, entries past
+LIMIT are evicted oldest first */
+struct lmemo
+{
+    int refs;
+    size_t limit;
+    size_t count;
+    // Slots in the table, a power of two
+    size_t cap;
+    lmemo_entry **table;
+    lmemo_entry *newest;
+    lmemo_entry *oldest;
+    unsigned long hits;
+    unsigned long misses;
+};
+
+/* Empty cache keeping at most LIMIT results */
+lmemo *lmemo_new(size_t limit);
+
+/* Share M with one more function */
+lmemo *lmemo_ref(lmemo *m);
+
+/* Drop a reference, the last one frees M and its results
+Does nothing on NULL */
+void lmemo_del(lmemo *m);
+
+/* Result cached for the Q-Expression ARGS, still owned by M
+NULL when missing. Counts a hit or a miss */
+lval *lmemo_get(lmemo *m, lval *args);
+
+/* Cache RESULT for ARGS, taking ownership of both */
+void lmemo_put(lmemo *m, lval *args, lval *result);
+
+/* (memo f) -> f answering repeated calls from a cache of LMEMO_LIMIT results
+(memo f n) -> the same with at most N results */
+lval *builtin_memo(lenv *e, lval *v);
+
+/* (memo-stats f) -> {hits misses size limit} */
+lval *builtin_memo_stats(lenv *e, lval *v);
+
+#endif
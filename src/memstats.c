@@ -0,0 +1,189 @@
+#include "memstats.h"
+#include "profile.h"
+
+typedef struct
+{
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long bytes;
+} mem_counter;
+
+static mem_counter mem_types[LVAL_TYPE_COUNT];
+
+/* Allocations per call site, keyed by the interned function name
+Open addressing on the name pointer, since equal names share one */
+typedef struct
+{
+    const char *name;
+    mem_counter count;
+} mem_site;
+
+static bool mem_sites_on = false;
+static mem_site *mem_sites = NULL;
+static size_t mem_sites_cap = 0;
+static size_t mem_sites_count = 0;
+
+static size_t mem_site_slot(mem_site *sites, size_t cap, const char *name)
+{
+    size_t i = ((size_t)name >> 4) & (cap - 1);
+    while (sites[i].name && sites[i].name != name)
+        i = (i + 1) & (cap - 1);
+    return i;
+}
+
+static mem_counter *mem_site_current(void)
+{
+    const char *name = PROF_ROOT;
+    if (prof_depth > 0)
+        name = prof_stack[(prof_depth < PROF_STACK_MAX ? prof_depth
+                                                       : PROF_STACK_MAX) -
+                          1];
+
+    // Keep the table at most half full
+    if (mem_sites_count * 2 >= mem_sites_cap)
+    {
+        size_t cap = mem_sites_cap ? mem_sites_cap * 2 : 256;
+        mem_site *sites = calloc(cap, sizeof(mem_site));
+        for (size_t i = 0; i < mem_sites_cap; i++)
+            if (mem_sites[i].name)
+                sites[mem_site_slot(sites, cap, mem_sites[i].name)] =
+                    mem_sites[i];
+        free(mem_sites);
+        mem_sites = sites;
+        mem_sites_cap = cap;
+    }
+
+    size_t i = mem_site_slot(mem_sites, mem_sites_cap, name);
+    if (!mem_sites[i].name)
+    {
+        mem_sites[i].name = name;
+        mem_sites_count++;
+    }
+
+    return &mem_sites[i].count;
+}
+
+void mem_alloc(lval *v)
+{
+    v->origin = v->type;
+    mem_types[v->type].allocs++;
+    mem_types[v->type].bytes += sizeof(lval);
+
+    if (mem_sites_on)
+    {
+        mem_counter *site = mem_site_current();
+        site->allocs++;
+        site->bytes += sizeof(lval);
+    }
+}
+
+void mem_payload(lval *v, size_t n)
+{
+    mem_shared(v->origin, n);
+}
+
+void mem_shared(int type, size_t n)
+{
+    mem_types[type].bytes += n;
+
+    if (mem_sites_on)
+        mem_site_current()->bytes += n;
+}
+
+void mem_free(lval *v)
+{
+    mem_types[v->origin].frees++;
+}
+
+unsigned long mem_allocs(void)
+{
+    unsigned long total = 0;
+    for (size_t i = 0; i < LVAL_TYPE_COUNT; i++)
+        total += mem_types[i].allocs;
+    return total;
+}
+
+void mem_track_sites(bool on)
+{
+    mem_sites_on = on;
+}
+
+static int mem_site_cmp(const void *a, const void *b)
+{
+    const mem_site *x = a, *y = b;
+    return (y->count.allocs > x->count.allocs) -
+           (y->count.allocs < x->count.allocs);
+}
+
+void mem_report(lbuf *b)
+{
+    lbuf_printf(b, "%-14s %12s %12s %12s %14s\n", "type", "allocs", "frees",
+                "live", "bytes");
+    for (size_t i = 0; i < LVAL_TYPE_COUNT; i++)
+    {
+        mem_counter *c = &mem_types[i];
+        lbuf_printf(b, "%-14s %12lu %12lu %12lu %14lu\n", ltype_name(i),
+                    c->allocs, c->frees, c->allocs - c->frees, c->bytes);
+    }
+
+    if (!mem_sites_count)
+        return;
+
+    // Heaviest allocators first
+    mem_site *sites = malloc(sizeof(mem_site) * mem_sites_count);
+    size_t n = 0;
+    for (size_t i = 0; i < mem_sites_cap; i++)
+        if (mem_sites[i].name)
+            sites[n++] = mem_sites[i];
+    qsort(sites, n, sizeof(mem_site), mem_site_cmp);
+
+    lbuf_printf(b, "\n%-14s %12s %14s\n", "site", "allocs", "bytes");
+    for (size_t i = 0; i < n; i++)
+        lbuf_printf(b, "%-14s %12lu %14lu\n", sites[i].name,
+                    sites[i].count.allocs, sites[i].count.bytes);
+    free(sites);
+}
+
+lval *builtin_mem_stats(lenv *e, lval *v)
+{
+    char *what = v->cell[0]->str;
+    LASSERT(v, strcmp(what, "types") == 0 || strcmp(what, "sites") == 0,
+            "Function mem-stats expects \"types\" or \"sites\" -- Got %s",
+            what);
+    bool types = strcmp(what, "types") == 0;
+    lval_del(v);
+
+    // Snapshot first so building the result is not counted in it
+    mem_counter snapshot[LVAL_TYPE_COUNT];
+    memcpy(snapshot, mem_types, sizeof(snapshot));
+    size_t n = 0;
+    mem_site *sites = malloc(sizeof(mem_site) * (mem_sites_count + 1));
+    for (size_t i = 0; i < mem_sites_cap; i++)
+        if (mem_sites[i].name)
+            sites[n++] = mem_sites[i];
+
+    lval *x = lval_qexpr();
+    for (size_t i = 0; types && i < LVAL_TYPE_COUNT; i++)
+    {
+        lval *row = lval_qexpr();
+        lval_add(row, lval_str(ltype_name(i)));
+        lval_add(row, lval_num(snapshot[i].allocs));
+        lval_add(row, lval_num(snapshot[i].frees));
+        lval_add(row, lval_num(snapshot[i].allocs - snapshot[i].frees));
+        lval_add(row, lval_num(snapshot[i].bytes));
+        lval_add(x, row);
+    }
+
+    qsort(sites, n, sizeof(mem_site), mem_site_cmp);
+    for (size_t i = 0; !types && i < n; i++)
+    {
+        lval *row = lval_qexpr();
+        lval_add(row, lval_str((char *)sites[i].name));
+        lval_add(row, lval_num(sites[i].count.allocs));
+        lval_add(row, lval_num(sites[i].count.bytes));
+        lval_add(x, row);
+    }
+    free(sites);
+
+    return x;
+}
@@ -0,0 +1,34 @@
+#ifndef memstats_h
+#define memstats_h
+
+#include "eval.h"
+
+/* Record construction of V under its current type */
+void mem_alloc(lval *v);
+
+/* Record N bytes of payload owned by V, such as its string or cell block */
+void mem_payload(lval *v, size_t n);
+
+/* Record N bytes of payload allocated for values of TYPE but owned by none
+in particular, such as vector nodes, map nodes and bignum limbs shared
+between copies */
+void mem_shared(int type, size_t n);
+
+/* Record destruction of V under the type it was constructed with */
+void mem_free(lval *v);
+
+/* Total lvals constructed since startup */
+unsigned long mem_allocs(void);
+
+/* Also attribute allocations to the innermost function on the call stack */
+void mem_track_sites(bool on);
+
+/* Write counters per type, and per call site when tracked, into B */
+void mem_report(lbuf *b);
+
+/* (mem-stats "types") -> {{"Number" allocs frees live bytes} ...}
+(mem-stats "sites") -> {{"fib" allocs bytes} ...}, heaviest first
+Sites are only tracked when enabled with mem_track_sites */
+lval *builtin_mem_stats(lenv *e, lval *v);
+
+#endif
@@ -55,6 +55,16 @@ static mpc_state_t mpc_state_new(void) {
 ** backtracking and make LL(1) grammars easy
 ** to parse for all input methods.
 **
+** Only the byte offset is tracked as input is
+** consumed, so a mark is a single integer. Rows
+** and columns are worked out from an index of
+** the newline offsets when an error or state is
+** handed out. Strings are indexed in one pass on
+** the first lookup, while files and pipes note
+** newlines the first time they are read. Lookups
+** walk from the previous one, as AST states come
+** in nearly increasing order.
+**
 */
 
 enum {
@@ -71,6 +81,10 @@ enum {
   MPC_INPUT_MEM_NUM = 512
 };
 
+enum {
+  MPC_INPUT_LOCATE_WALK = 8
+};
+
 typedef struct {
   char mem[64];
 } mpc_mem_t;
@@ -79,7 +93,8 @@ typedef struct {
 
   int type;
   char *filename;
-  mpc_state_t state;
+  long pos;
+  int term;
 
   char *string;
   char *buffer;
@@ -89,11 +104,19 @@ typedef struct {
   int backtrack;
   int marks_slots;
   int marks_num;
-  mpc_state_t *marks;
+  long *marks;
 
   char *lasts;
   char last;
 
+  long lines_end;
+  long lines_num;
+  long lines_slots;
+  long *lines;
+
+  long locate_pos;
+  long locate_row;
+
   size_t mem_index;
   char mem_full[MPC_INPUT_MEM_NUM];
   mpc_mem_t mem[MPC_INPUT_MEM_NUM];
@@ -108,7 +131,8 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   strcpy(i->filename, filename);
   i->type = MPC_INPUT_STRING;
 
-  i->state = mpc_state_new();
+  i->pos = 0;
+  i->term = 0;
 
   i->string = malloc(strlen(string) + 1);
   strcpy(i->string, string);
@@ -119,10 +143,17 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   i->backtrack = 1;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
+  i->marks = malloc(sizeof(long) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->lines_end = 0;
+  i->lines_num = 0;
+  i->lines_slots = 0;
+  i->lines = NULL;
+  i->locate_pos = 0;
+  i->locate_row = 0;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
@@ -137,7 +168,8 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   strcpy(i->filename, filename);
   i->type = MPC_INPUT_STRING;
 
-  i->state = mpc_state_new();
+  i->pos = 0;
+  i->term = 0;
 
   i->string = malloc(length + 1);
   strncpy(i->string, string, length);
@@ -149,10 +181,17 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   i->backtrack = 1;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
+  i->marks = malloc(sizeof(long) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->lines_end = 0;
+  i->lines_num = 0;
+  i->lines_slots = 0;
+  i->lines = NULL;
+  i->locate_pos = 0;
+  i->locate_row = 0;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
@@ -168,7 +207,8 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   strcpy(i->filename, filename);
 
   i->type = MPC_INPUT_PIPE;
-  i->state = mpc_state_new();
+  i->pos = 0;
+  i->term = 0;
 
   i->string = NULL;
   i->buffer = NULL;
@@ -178,10 +218,17 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   i->backtrack = 1;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
+  i->marks = malloc(sizeof(long) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->lines_end = 0;
+  i->lines_num = 0;
+  i->lines_slots = 0;
+  i->lines = NULL;
+  i->locate_pos = 0;
+  i->locate_row = 0;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
@@ -196,7 +243,8 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->filename = malloc(strlen(filename) + 1);
   strcpy(i->filename, filename);
   i->type = MPC_INPUT_FILE;
-  i->state = mpc_state_new();
+  i->pos = 0;
+  i->term = 0;
 
   i->string = NULL;
   i->buffer = NULL;
@@ -206,10 +254,17 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->backtrack = 1;
   i->marks_num = 0;
   i->marks_slots = MPC_INPUT_MARKS_MIN;
-  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
+  i->marks = malloc(sizeof(long) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
+  i->lines_end = 0;
+  i->lines_num = 0;
+  i->lines_slots = 0;
+  i->lines = NULL;
+  i->locate_pos = 0;
+  i->locate_row = 0;
+
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
 
@@ -225,6 +280,7 @@ static void mpc_input_delete(mpc_input_t *i) {
 
   free(i->marks);
   free(i->lasts);
+  free(i->lines);
   free(i);
 }
 
@@ -298,6 +354,9 @@ static void mpc_input_backtrack_enable(mpc_input_t *i) { i->backtrack++; }
 static void mpc_input_suppress_disable(mpc_input_t *i) { i->suppress--; }
 static void mpc_input_suppress_enable(mpc_input_t *i) { i->suppress++; }
 
+/* Marks keep the terminated flag in the low bit of the offset */
+#define MPC_INPUT_MARK_POS(m) ((m) >> 1)
+
 static void mpc_input_mark(mpc_input_t *i) {
 
   if (i->backtrack < 1) { return; }
@@ -306,11 +365,11 @@ static void mpc_input_mark(mpc_input_t *i) {
 
   if (i->marks_num > i->marks_slots) {
     i->marks_slots = i->marks_num + i->marks_num / 2;
-    i->marks = realloc(i->marks, sizeof(mpc_state_t) * i->marks_slots);
+    i->marks = realloc(i->marks, sizeof(long) * i->marks_slots);
     i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);
   }
 
-  i->marks[i->marks_num-1] = i->state;
+  i->marks[i->marks_num-1] = i->pos << 1 | i->term;
   i->lasts[i->marks_num-1] = i->last;
 
   if (i->type == MPC_INPUT_PIPE && i->marks_num == 1) {
@@ -331,7 +390,7 @@ static void mpc_input_unmark(mpc_input_t *i) {
     i->marks_slots =
       i->marks_num > MPC_INPUT_MARKS_MIN ?
       i->marks_num : MPC_INPUT_MARKS_MIN;
-    i->marks = realloc(i->marks, sizeof(mpc_state_t) * i->marks_slots);
+    i->marks = realloc(i->marks, sizeof(long) * i->marks_slots);
     i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);
   }
 
@@ -349,22 +408,23 @@ static void mpc_input_rewind(mpc_input_t *i) {
 
   if (i->backtrack < 1) { return; }
 
-  i->state = i->marks[i->marks_num-1];
-  i->last  = i->lasts[i->marks_num-1];
+  i->pos  = MPC_INPUT_MARK_POS(i->marks[i->marks_num-1]);
+  i->term = i->marks[i->marks_num-1] & 1;
+  i->last = i->lasts[i->marks_num-1];
 
   if (i->type == MPC_INPUT_FILE) {
-    fseek(i->file, i->state.pos, SEEK_SET);
+    fseek(i->file, i->pos, SEEK_SET);
   }
 
   mpc_input_unmark(i);
 }
 
 static int mpc_input_buffer_in_range(mpc_input_t *i) {
-  return i->state.pos < (long)(strlen(i->buffer) + i->marks[0].pos);
+  return i->pos < (long)(strlen(i->buffer) + MPC_INPUT_MARK_POS(i->marks[0]));
 }
 
 static char mpc_input_buffer_get(mpc_input_t *i) {
-  return i->buffer[i->state.pos - i->marks[0].pos];
+  return i->buffer[i->pos - MPC_INPUT_MARK_POS(i->marks[0])];
 }
 
 static char mpc_input_getc(mpc_input_t *i) {
@@ -373,7 +433,7 @@ static char mpc_input_getc(mpc_input_t *i) {
 
   switch (i->type) {
 
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
+    case MPC_INPUT_STRING: return i->string[i->pos];
     case MPC_INPUT_FILE: c = fgetc(i->file); return c;
     case MPC_INPUT_PIPE:
 
@@ -396,7 +456,7 @@ static char mpc_input_peekc(mpc_input_t *i) {
   char c = '\0';
 
   switch (i->type) {
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
+    case MPC_INPUT_STRING: return i->string[i->pos];
     case MPC_INPUT_FILE:
 
       c = fgetc(i->file);
@@ -452,6 +512,14 @@ static int mpc_input_failure(mpc_input_t *i, char c) {
   return 0;
 }
 
+static void mpc_input_line(mpc_input_t *i, long pos) {
+  if (i->lines_num == i->lines_slots) {
+    i->lines_slots = i->lines_slots ? i->lines_slots * 2 : 64;
+    i->lines = realloc(i->lines, sizeof(long) * i->lines_slots);
+  }
+  i->lines[i->lines_num++] = pos;
+}
+
 static int mpc_input_success(mpc_input_t *i, char c, char **o) {
 
   if (i->type == MPC_INPUT_PIPE
@@ -461,15 +529,15 @@ static int mpc_input_success(mpc_input_t *i, char c, char **o) {
     i->buffer[strlen(i->buffer) + 0] = c;
   }
 
-  i->last = c;
-  i->state.pos++;
-  i->state.col++;
-
-  if (c == '\n') {
-    i->state.col = 0;
-    i->state.row++;
+  /* Strings are indexed when asked, other input only passes once */
+  if (i->type != MPC_INPUT_STRING && i->pos == i->lines_end) {
+    if (c == '\n') { mpc_input_line(i, i->pos); }
+    i->lines_end++;
   }
 
+  i->last = c;
+  i->pos++;
+
   if (o) {
     (*o) = mpc_malloc(i, 2);
     (*o)[0] = c;
@@ -540,6 +608,225 @@ static int mpc_input_string(mpc_input_t *i, const char *c, char **o) {
   return 1;
 }
 
+/*
+** Span Scanning
+**
+** A span consumes the longest run of characters
+** in a set and returns it as a single string.
+** An escape character, when given, also takes
+** the character after it if that is in a second
+** set, as string bodies do.
+**
+** On string input, past a first short stretch,
+** the bytes which can not end the run are then
+** skipped with SSE2 or AVX2 when the set, or the
+** set of bytes ending it, is small. The
+** instruction set is picked at runtime. Other
+** inputs go through one character at a time.
+*/
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(MPC_NO_SIMD)
+#define MPC_SPAN_SIMD 1
+#include <stdint.h>
+#include <immintrin.h>
+#else
+#define MPC_SPAN_SIMD 0
+#endif
+
+enum {
+  MPC_SPAN_STOPS = 8,
+  MPC_SPAN_SHORT = 32
+};
+
+typedef struct {
+  unsigned char set[32];
+  unsigned char follow[32];
+  char esc;
+  /* With `vector`, the run continues over `stops` if `in`, else up to them */
+  char vector;
+  char in;
+  int stops_num;
+  char stops[MPC_SPAN_STOPS];
+} mpc_span_t;
+
+#define MPC_SPAN_HAS(set, c) ((set)[(unsigned char)(c) >> 3] & (1 << ((unsigned char)(c) & 7)))
+
+typedef size_t (*mpc_span_skip_t)(const char *s, const mpc_span_t *sp);
+
+/* Length of the prefix of `s` in the set, stopping at the escape */
+static size_t mpc_span_skip_scalar(const char *s, const mpc_span_t *sp) {
+  const char *e = s;
+  while (MPC_SPAN_HAS(sp->set, *e) && *e != sp->esc) { e++; }
+  return e - s;
+}
+
+/* As above but only looking at the first `n` bytes */
+static size_t mpc_span_skip_short(const char *s, const mpc_span_t *sp, size_t n) {
+  const char *e = s;
+  while (e - s < n && MPC_SPAN_HAS(sp->set, *e) && *e != sp->esc) { e++; }
+  return e - s;
+}
+
+#if MPC_SPAN_SIMD
+
+/*
+** Blocks are loaded aligned, so reads past the
+** end of the string never leave its last page.
+*/
+
+__attribute__((target("sse2"), no_sanitize_address))
+static size_t mpc_span_skip_sse2(const char *s, const mpc_span_t *sp) {
+  const char *b = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+  unsigned int bits, start = ~0u << (s - b);
+  __m128i stops[MPC_SPAN_STOPS], v, m;
+  int k;
+
+  for (k = 0; k < sp->stops_num; k++) { stops[k] = _mm_set1_epi8(sp->stops[k]); }
+
+  for (;; b += 16) {
+    v = _mm_load_si128((const __m128i *)b);
+    m = _mm_setzero_si128();
+    for (k = 0; k < sp->stops_num; k++) { m = _mm_or_si128(m, _mm_cmpeq_epi8(v, stops[k])); }
+    bits = (unsigned int)_mm_movemask_epi8(m);
+    if (sp->in) { bits = ~bits & 0xFFFF; }
+    bits &= start;
+    start = ~0u;
+    if (bits) { return b + __builtin_ctz(bits) - s; }
+  }
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+static size_t mpc_span_skip_avx2(const char *s, const mpc_span_t *sp) {
+  const char *b = (const char *)((uintptr_t)s & ~(uintptr_t)31);
+  unsigned int bits, start = ~0u << (s - b);
+  __m256i stops[MPC_SPAN_STOPS], v, m;
+  int k;
+
+  for (k = 0; k < sp->stops_num; k++) { stops[k] = _mm256_set1_epi8(sp->stops[k]); }
+
+  for (;; b += 32) {
+    v = _mm256_load_si256((const __m256i *)b);
+    m = _mm256_setzero_si256();
+    for (k = 0; k < sp->stops_num; k++) { m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, stops[k])); }
+    bits = (unsigned int)_mm256_movemask_epi8(m);
+    if (sp->in) { bits = ~bits; }
+    bits &= start;
+    start = ~0u;
+    if (bits) { return b + __builtin_ctz(bits) - s; }
+  }
+}
+
+#endif
+
+static mpc_span_skip_t mpc_span_skip = NULL;
+
+static void mpc_span_dispatch(void) {
+  mpc_span_skip = mpc_span_skip_scalar;
+#if MPC_SPAN_SIMD
+  if (__builtin_cpu_supports("avx2")) {
+    mpc_span_skip = mpc_span_skip_avx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    mpc_span_skip = mpc_span_skip_sse2;
+  }
+#endif
+}
+
+/* Decide whether the bytes ending a run are few enough to compare against */
+static void mpc_span_stops(mpc_span_t *sp) {
+
+  int c, in = 0, out = 0;
+
+  for (c = 0; c < 256; c++) {
+    if (MPC_SPAN_HAS(sp->set, c) && c != (unsigned char)sp->esc) { in++; } else { out++; }
+  }
+
+  sp->vector = in <= MPC_SPAN_STOPS || out <= MPC_SPAN_STOPS;
+  sp->in = in <= MPC_SPAN_STOPS;
+  sp->stops_num = 0;
+  if (!sp->vector) { return; }
+
+  for (c = 0; c < 256; c++) {
+    if ((MPC_SPAN_HAS(sp->set, c) && c != (unsigned char)sp->esc) == sp->in) {
+      sp->stops[sp->stops_num++] = (char)c;
+    }
+  }
+}
+
+static int mpc_input_span(mpc_input_t *i, const mpc_span_t *sp, char **o, int *lone) {
+
+  char *s, *e, x, y;
+  size_t k, n = 0, cap = sizeof(mpc_mem_t);
+  mpc_span_skip_t skip;
+
+  /* Whether the span ends with an escape taken as itself */
+  *lone = 0;
+
+  if (i->type == MPC_INPUT_STRING) {
+
+    if (!mpc_span_skip) { mpc_span_dispatch(); }
+    skip = sp->vector ? mpc_span_skip : mpc_span_skip_scalar;
+
+    /* The terminator is never in the set, most runs are short */
+    s = e = i->string + i->pos;
+    while (1) {
+      k = mpc_span_skip_short(e, sp, MPC_SPAN_SHORT);
+      if (k == MPC_SPAN_SHORT) { k += skip(e + k, sp); }
+      if (k) { e += k; *lone = 0; }
+      if (sp->esc && *e == sp->esc && MPC_SPAN_HAS(sp->follow, e[1])) { e += 2; *lone = 0; continue; }
+      if (MPC_SPAN_HAS(sp->set, *e)) { *lone = sp->esc && *e == sp->esc; e++; continue; }
+      break;
+    }
+
+    n = e - s;
+    if (n) { i->last = e[-1]; }
+    i->pos += n;
+
+    *o = mpc_malloc(i, n + 1);
+    memcpy(*o, s, n);
+    (*o)[n] = '\0';
+    return n;
+  }
+
+  s = mpc_malloc(i, cap);
+  while (!mpc_input_terminated(i)) {
+
+    x = mpc_input_peekc(i);
+
+    /* An escape not followed by an escaped character is given back */
+    if (sp->esc && x == sp->esc) {
+      mpc_input_mark(i);
+      mpc_input_char(i, x, NULL);
+      y = mpc_input_peekc(i);
+      if (!mpc_input_terminated(i) && MPC_SPAN_HAS(sp->follow, y)) {
+        mpc_input_char(i, y, NULL);
+        mpc_input_unmark(i);
+        *lone = 0;
+      } else if (MPC_SPAN_HAS(sp->set, x)) {
+        y = '\0';
+        mpc_input_unmark(i);
+        *lone = 1;
+      } else {
+        mpc_input_rewind(i);
+        break;
+      }
+    } else if (MPC_SPAN_HAS(sp->set, x)) {
+      mpc_input_char(i, x, NULL);
+      y = '\0';
+      *lone = 0;
+    } else {
+      break;
+    }
+
+    if (n + 3 > cap) { cap *= 2; s = mpc_realloc(i, s, cap); }
+    s[n++] = x;
+    if (y) { s[n++] = y; }
+  }
+
+  s[n] = '\0';
+  *o = s;
+  return n;
+}
+
 static int mpc_input_anchor(mpc_input_t* i, int(*f)(char,char), char **o) {
   *o = NULL;
   return f(i->last, mpc_input_peekc(i));
@@ -552,19 +839,74 @@ static int mpc_input_soi(mpc_input_t* i, char **o) {
 
 static int mpc_input_eoi(mpc_input_t* i, char **o) {
   *o = NULL;
-  if (i->state.term) {
+  if (i->term) {
     return 0;
   } else if (mpc_input_terminated(i)) {
-    i->state.term = 1;
+    i->term = 1;
     return 1;
   } else {
     return 0;
   }
 }
 
+/* The state at the current offset, rows and columns are left for `mpc_input_locate` */
+static mpc_state_t mpc_input_state(mpc_input_t *i) {
+  mpc_state_t s;
+  s.pos = i->pos;
+  s.row = 0;
+  s.col = 0;
+  s.term = i->term;
+  return s;
+}
+
+/* Fill in the row and column of a state from the newline index */
+static void mpc_input_locate(mpc_input_t *i, mpc_state_t *s) {
+
+  const char *e, *n;
+  long lo, hi, mid;
+  int k;
+
+  if (s->pos < 0) { return; }
+
+  /* Strings are indexed to their end in one pass */
+  if (i->type == MPC_INPUT_STRING && s->pos > i->lines_end) {
+    e = i->string + s->pos + strlen(i->string + s->pos);
+    for (n = i->string + i->lines_end; (n = memchr(n, '\n', e - n)) != NULL; n++) {
+      mpc_input_line(i, n - i->string);
+    }
+    i->lines_end = e - i->string;
+  }
+
+  /*
+  ** Count the newlines before the offset. Lookups
+  ** come in nearly increasing order, so walk a few
+  ** lines from the last one before searching.
+  */
+  if (s->pos >= i->locate_pos) {
+    lo = i->locate_row;
+    for (k = 0; k < MPC_INPUT_LOCATE_WALK && lo < i->lines_num && i->lines[lo] < s->pos; k++) { lo++; }
+    hi = (lo == i->lines_num || i->lines[lo] >= s->pos) ? lo : i->lines_num;
+  } else {
+    hi = i->locate_row;
+    for (k = 0; k < MPC_INPUT_LOCATE_WALK && hi > 0 && i->lines[hi-1] >= s->pos; k++) { hi--; }
+    lo = (hi == 0 || i->lines[hi-1] < s->pos) ? hi : 0;
+  }
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (i->lines[mid] < s->pos) { lo = mid + 1; } else { hi = mid; }
+  }
+
+  i->locate_pos = s->pos;
+  i->locate_row = lo;
+  s->row = lo;
+  s->col = lo ? s->pos - i->lines[lo-1] - 1 : s->pos;
+}
+
 static mpc_state_t *mpc_input_state_copy(mpc_input_t *i) {
   mpc_state_t *r = mpc_malloc(i, sizeof(mpc_state_t));
-  memcpy(r, &i->state, sizeof(mpc_state_t));
+  *r = mpc_input_state(i);
+  mpc_input_locate(i, r);
   return r;
 }
 
@@ -668,7 +1010,7 @@ static mpc_err_t *mpc_err_new(mpc_input_t *i, const char *expected) {
   x = mpc_malloc(i, sizeof(mpc_err_t));
   x->filename = mpc_malloc(i, strlen(i->filename) + 1);
   strcpy(x->filename, i->filename);
-  x->state = i->state;
+  x->state = mpc_input_state(i);
   x->expected_num = 1;
   x->expected = mpc_malloc(i, sizeof(char*));
   x->expected[0] = mpc_malloc(i, strlen(expected) + 1);
@@ -684,7 +1026,7 @@ static mpc_err_t *mpc_err_fail(mpc_input_t *i, const char *failure) {
   x = mpc_malloc(i, sizeof(mpc_err_t));
   x->filename = mpc_malloc(i, strlen(i->filename) + 1);
   strcpy(x->filename, i->filename);
-  x->state = i->state;
+  x->state = mpc_input_state(i);
   x->expected_num = 0;
   x->expected = NULL;
   x->failure = mpc_malloc(i, strlen(failure) + 1);
@@ -916,7 +1258,9 @@ enum {
   MPC_TYPE_CHECK_WITH = 26,
 
   MPC_TYPE_SOI        = 27,
-  MPC_TYPE_EOI        = 28
+  MPC_TYPE_EOI        = 28,
+
+  MPC_TYPE_SPAN       = 29
 };
 
 typedef struct { char *m; } mpc_pdata_fail_t;
@@ -936,6 +1280,7 @@ typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; } mpc_pdata_not_
 typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_repeat_t;
 typedef struct { int n; mpc_parser_t **xs; } mpc_pdata_or_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t **xs; mpc_dtor_t *dxs;  } mpc_pdata_and_t;
+typedef struct { mpc_parser_t *x; int min; mpc_span_t *s; } mpc_pdata_span_t;
 
 typedef union {
   mpc_pdata_fail_t fail;
@@ -955,10 +1300,18 @@ typedef union {
   mpc_pdata_repeat_t repeat;
   mpc_pdata_and_t and;
   mpc_pdata_or_t or;
+  mpc_pdata_span_t span;
 } mpc_pdata_t;
 
+/*
+** Primitive parsers may carry the message of an
+** `expect` wrapper that was folded into them by
+** the optimiser, reported when they fail.
+*/
+
 struct mpc_parser_t {
   char *name;
+  char *expected;
   mpc_pdata_t data;
   char type;
   char retained;
@@ -1042,7 +1395,7 @@ enum {
 #define MPC_FAILURE(x) r->error = x; return 0
 #define MPC_PRIMITIVE(x) \
   if (x) { MPC_SUCCESS(r->output); } \
-  else { MPC_FAILURE(NULL); }
+  else { MPC_FAILURE(p->expected ? mpc_err_new(i, p->expected) : NULL); }
 
 #define MPC_MAX_RECURSION_DEPTH 1000
 
@@ -1073,6 +1426,27 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
     case MPC_TYPE_SOI:     MPC_PRIMITIVE(mpc_input_soi(i, (char**)&r->output));
     case MPC_TYPE_EOI:     MPC_PRIMITIVE(mpc_input_eoi(i, (char**)&r->output));
 
+    /* A fused `many`, its element is only run where the span
+       stops so errors read as they did, unless an expected
+       message hides them */
+
+    case MPC_TYPE_SPAN:
+      j = mpc_input_span(i, p->data.span.s, (char**)&r->output, &k);
+      if (j >= p->data.span.min) {
+        /* A trailing lone escape still expected its escaped character */
+        if (!p->expected && k && !mpc_parse_run(i, p->data.span.x->data.or.xs[0]->data.and.xs[1], &results_stk[0], e, depth+1)) {
+          *e = mpc_err_merge(i, *e, results_stk[0].error);
+        }
+        if (!p->expected && !mpc_parse_run(i, p->data.span.x, &results_stk[0], e, depth+1)) {
+          *e = mpc_err_merge(i, *e, results_stk[0].error);
+        }
+        MPC_SUCCESS(r->output);
+      }
+      mpc_free(i, r->output);
+      if (p->expected) { MPC_FAILURE(mpc_err_new(i, p->expected)); }
+      mpc_parse_run(i, p->data.span.x, &results_stk[0], e, depth+1);
+      MPC_FAILURE(mpc_err_many1(i, results_stk[0].error));
+
     /* Other parsers */
 
     case MPC_TYPE_UNDEFINED: MPC_FAILURE(mpc_err_fail(i, "Parser Undefined!"));
@@ -1316,6 +1690,7 @@ int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
     r->output = mpc_export(i, r->output);
   } else {
     r->error = mpc_err_export(i, mpc_err_merge(i, e, r->error));
+    mpc_input_locate(i, &r->error->state);
   }
   return x;
 }
@@ -1355,6 +1730,8 @@ int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result
 int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
 
   FILE *f = fopen(filename, "rb");
+  char *buffer;
+  long size;
   int res;
 
   if (f == NULL) {
@@ -1363,8 +1740,30 @@ int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
     return 0;
   }
 
-  res = mpc_parse_file(filename, f, p, r);
+  /*
+  ** Read the whole file and parse it as a string,
+  ** so the span scanners of string inputs apply.
+  ** Files that cannot be sized are read as they go.
+  */
+  if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET) != 0) {
+    res = mpc_parse_file(filename, f, p, r);
+    fclose(f);
+    return res;
+  }
+
+  buffer = malloc(size + 1);
+  if (fread(buffer, 1, size, f) != (size_t)size) {
+    free(buffer);
+    rewind(f);
+    res = mpc_parse_file(filename, f, p, r);
+    fclose(f);
+    return res;
+  }
   fclose(f);
+
+  res = mpc_nparse(filename, buffer, size, p, r);
+  free(buffer);
   return res;
 }
 
@@ -1442,9 +1841,17 @@ static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
       free(p->data.check_with.e);
       break;
 
+    case MPC_TYPE_SPAN:
+      mpc_undefine_unretained(p->data.span.x, 0);
+      free(p->data.span.s);
+      break;
+
     default: break;
   }
 
+  free(p->expected);
+  p->expected = NULL;
+
   if (!force) {
     free(p->name);
     free(p);
@@ -1503,6 +1910,11 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
     strcpy(p->name, a->name);
   }
 
+  if (a->expected) {
+    p->expected = malloc(strlen(a->expected)+1);
+    strcpy(p->expected, a->expected);
+  }
+
   switch (a->type) {
 
     case MPC_TYPE_FAIL:
@@ -1566,6 +1978,12 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
       strcpy(p->data.check_with.e, a->data.check_with.e);
       break;
 
+    case MPC_TYPE_SPAN:
+      p->data.span.x = mpc_copy(a->data.span.x);
+      p->data.span.s = malloc(sizeof(mpc_span_t));
+      memcpy(p->data.span.s, a->data.span.s, sizeof(mpc_span_t));
+      break;
+
     default: break;
   }
 
@@ -1584,6 +2002,7 @@ mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a) {
   if (p->retained) {
     p->type = a->type;
     p->data = a->data;
+    p->expected = a->expected;
   } else {
     mpc_parser_t *a2 = mpc_failf("Attempt to assign to Unretained Parser!");
     p->type = a2->type;
@@ -2423,7 +2842,7 @@ mpc_parser_t *mpc_re_mode(const char *re, int mode) {
 
   mpc_cleanup(6, RegexEnclose, Regex, Term, Factor, Base, Range);
 
-  mpc_optimise(r.output);
+  if (!(mode & MPC_RE_NO_OPTIMISE)) { mpc_optimise(r.output); }
 
   return r.output;
 
@@ -2688,6 +3107,11 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
     return;
   }
 
+  if (p->expected) {
+    printf("%s", p->expected);
+    return;
+  }
+
   if (p->type == MPC_TYPE_UNDEFINED) { printf("<?>"); }
   if (p->type == MPC_TYPE_PASS)   { printf("<:>"); }
   if (p->type == MPC_TYPE_FAIL)   { printf("<!>"); }
@@ -2755,6 +3179,11 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
     free(s);
   }
 
+  if (p->type == MPC_TYPE_SPAN) {
+    mpc_print_unretained(p->data.span.x, 0);
+    printf(p->data.span.min ? "+" : "*");
+  }
+
   if (p->type == MPC_TYPE_APPLY)    { mpc_print_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { mpc_print_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { mpc_print_unretained(p->data.predict.x, 0); }
@@ -3430,6 +3859,7 @@ static mpc_val_t *mpcaf_fold_regex(int n, mpc_val_t **xs) {
   (void)n;
   if (strchr(m, 'm')) { mode |= MPC_RE_MULTILINE; }
   if (strchr(m, 's')) { mode |= MPC_RE_DOTALL; }
+  if (st->flags & MPCA_LANG_NO_OPTIMISE) { mode |= MPC_RE_NO_OPTIMISE; }
   y = mpcf_unescape_regex(y);
   p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_re_mode(y, mode) : mpc_tok(mpc_re_mode(y, mode));
   free(y);
@@ -3650,7 +4080,7 @@ static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
     left = mpca_grammar_find_parser(stmt->ident, st);
     if (st->flags & MPCA_LANG_PREDICTIVE) { stmt->grammar = mpc_predictive(stmt->grammar); }
     if (stmt->name) { stmt->grammar = mpc_expect(stmt->grammar, stmt->name); }
-    mpc_optimise(stmt->grammar);
+    if (!(st->flags & MPCA_LANG_NO_OPTIMISE)) { mpc_optimise(stmt->grammar); }
     mpc_define(left, stmt->grammar);
     free(stmt->ident);
     free(stmt->name);
@@ -3881,10 +4311,127 @@ void mpc_stats(mpc_parser_t* p) {
   printf("Node Count: %i\n", mpc_nodecount_unretained(p, 1));
 }
 
+static int mpc_optimise_primitive(mpc_parser_t *p) {
+  switch (p->type) {
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+    case MPC_TYPE_STRING:
+    case MPC_TYPE_ANCHOR:
+    case MPC_TYPE_SOI:
+    case MPC_TYPE_EOI:
+    case MPC_TYPE_SPAN:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/*
+** Replaces `p` by its unretained child `t`. A
+** retained `p` keeps its name, as it is shared
+** and referenced by name in the AST tags.
+*/
+
+static void mpc_optimise_replace(mpc_parser_t *p, mpc_parser_t *t) {
+  char *name = p->name;
+  char retained = p->retained;
+  memcpy(p, t, sizeof(mpc_parser_t));
+  if (retained) {
+    free(t->name);
+    p->name = name;
+    p->retained = retained;
+  } else {
+    free(name);
+  }
+  free(t);
+}
+
+/* Fill `set` with the bytes matched by a character class */
+static int mpc_optimise_charset(mpc_parser_t *p, unsigned char *set) {
+
+  int c, in;
+
+  if (p->retained) { return 0; }
+
+  switch (p->type) {
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      break;
+    default:
+      return 0;
+  }
+
+  /* The terminator is never matched */
+  memset(set, 0, 32);
+  for (c = 1; c < 256; c++) {
+    switch (p->type) {
+      case MPC_TYPE_SINGLE: in = (char)c == p->data.single.x; break;
+      case MPC_TYPE_RANGE:  in = (char)c >= p->data.range.x && (char)c <= p->data.range.y; break;
+      case MPC_TYPE_ONEOF:  in = strchr(p->data.string.x, c) != NULL; break;
+      case MPC_TYPE_NONEOF: in = strchr(p->data.string.x, c) == NULL; break;
+      default:              in = 1; break;
+    }
+    if (in) { set[c >> 3] |= 1 << (c & 7); }
+  }
+
+  return 1;
+}
+
+/*
+** Spans take `many` of a character class, or of
+** `(e x) | y` where `e` is a single character and
+** `x` and `y` character classes, as in strings.
+*/
+
+static mpc_span_t *mpc_optimise_span(mpc_parser_t *p) {
+
+  mpc_parser_t *a;
+  mpc_span_t *sp = calloc(1, sizeof(mpc_span_t));
+
+  if (mpc_optimise_charset(p, sp->set)) {
+    mpc_span_stops(sp);
+    return sp;
+  }
+
+  if (p->type == MPC_TYPE_OR
+  &&  p->data.or.n == 2
+  && !p->data.or.xs[0]->retained
+  &&  p->data.or.xs[0]->type == MPC_TYPE_AND) {
+    a = p->data.or.xs[0];
+    if (a->data.and.n == 2
+    &&  a->data.and.f == mpcf_strfold
+    && !a->data.and.xs[0]->retained
+    &&  a->data.and.xs[0]->type == MPC_TYPE_SINGLE
+    &&  a->data.and.xs[0]->data.single.x
+    &&  mpc_optimise_charset(a->data.and.xs[1], sp->follow)
+    &&  mpc_optimise_charset(p->data.or.xs[1], sp->set)) {
+      sp->esc = a->data.and.xs[0]->data.single.x;
+      mpc_span_stops(sp);
+      return sp;
+    }
+  }
+
+  free(sp);
+  return NULL;
+}
+
+static int mpc_optimise_literal(mpc_parser_t *p) {
+  return (p->type == MPC_TYPE_SINGLE || p->type == MPC_TYPE_STRING) && !p->retained;
+}
+
 static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
 
-  int i, n, m;
+  int i, j, n, m;
+  char *c;
   mpc_parser_t *t;
+  mpc_span_t *sp;
 
   if (p->retained && !force) { return; }
 
@@ -3950,12 +4497,12 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
     &&  p->data.and.n == 2
     &&  p->data.and.xs[0]->type == MPC_TYPE_PASS
     && !p->data.and.xs[0]->retained
-    &&  p->data.and.f == mpcf_fold_ast) {
+    &&  p->data.and.f == mpcf_fold_ast
+    && !p->data.and.xs[1]->retained) {
       t = p->data.and.xs[1];
       mpc_delete(p->data.and.xs[0]);
-      free(p->data.and.xs); free(p->data.and.dxs); free(p->name);
-      memcpy(p, t, sizeof(mpc_parser_t));
-      free(t);
+      free(p->data.and.xs); free(p->data.and.dxs);
+      mpc_optimise_replace(p, t);
       continue;
     }
 
@@ -4000,12 +4547,12 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
     &&  p->data.and.xs[0]->type == MPC_TYPE_LIFT
     &&  p->data.and.xs[0]->data.lift.lf == mpcf_ctor_str
     && !p->data.and.xs[0]->retained
-    &&  p->data.and.f == mpcf_strfold) {
+    &&  p->data.and.f == mpcf_strfold
+    && !p->data.and.xs[1]->retained) {
       t = p->data.and.xs[1];
       mpc_delete(p->data.and.xs[0]);
-      free(p->data.and.xs); free(p->data.and.dxs); free(p->name);
-      memcpy(p, t, sizeof(mpc_parser_t));
-      free(t);
+      free(p->data.and.xs); free(p->data.and.dxs);
+      mpc_optimise_replace(p, t);
       continue;
     }
 
@@ -4044,6 +4591,77 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       continue;
     }
 
+    /* Fold `expect` into primitive, the outermost message wins */
+    if (p->type == MPC_TYPE_EXPECT
+    && !p->data.expect.x->retained
+    &&  mpc_optimise_primitive(p->data.expect.x)) {
+      t = p->data.expect.x;
+      free(t->expected);
+      t->expected = p->data.expect.m;
+      mpc_optimise_replace(p, t);
+      continue;
+    }
+
+    /* Fuse re `many` of character class into `span` */
+    if ((p->type == MPC_TYPE_MANY || p->type == MPC_TYPE_MANY1)
+    &&  p->data.repeat.f == mpcf_strfold
+    && !p->data.repeat.x->retained
+    &&  (sp = mpc_optimise_span(p->data.repeat.x)) != NULL) {
+      t = p->data.repeat.x;
+      p->data.span.min = p->type == MPC_TYPE_MANY1;
+      p->data.span.x = t;
+      p->data.span.s = sp;
+      p->type = MPC_TYPE_SPAN;
+      continue;
+    }
+
+    /* Merge re `char` and `string` chain into `string` */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.f == mpcf_strfold) {
+      for (i = 0; i < p->data.and.n-1; i++) {
+        if (mpc_optimise_literal(p->data.and.xs[i])
+        &&  mpc_optimise_literal(p->data.and.xs[i+1])) { break; }
+      }
+      if (i < p->data.and.n-1) {
+        m = 0;
+        for (j = i; j < p->data.and.n && mpc_optimise_literal(p->data.and.xs[j]); j++) {
+          t = p->data.and.xs[j];
+          m += t->type == MPC_TYPE_SINGLE ? 1 : strlen(t->data.string.x);
+        }
+        n = j - i;
+        c = calloc(1, m + 1);
+        for (m = 0; m < n; m++) {
+          t = p->data.and.xs[i+m];
+          if (t->type == MPC_TYPE_SINGLE) { c[strlen(c)] = t->data.single.x; }
+          else { strcat(c, t->data.string.x); }
+          mpc_delete(t);
+        }
+        t = mpc_undefined();
+        t->type = MPC_TYPE_STRING;
+        t->data.string.x = c;
+        t->expected = malloc(strlen(c) + 3);
+        sprintf(t->expected, "\"%s\"", c);
+        p->data.and.xs[i] = t;
+        memmove(p->data.and.xs + i + 1, p->data.and.xs + j, (p->data.and.n - j) * sizeof(mpc_parser_t*));
+        if (j < p->data.and.n) {
+          memmove(p->data.and.dxs + i + 1, p->data.and.dxs + j, (p->data.and.n - 1 - j) * sizeof(mpc_dtor_t));
+        }
+        p->data.and.n -= n - 1;
+        continue;
+      }
+    }
+
+    /* Remove re `and` of one */
+    if (p->type == MPC_TYPE_AND
+    &&  p->data.and.n == 1
+    &&  p->data.and.f == mpcf_strfold
+    && !p->data.and.xs[0]->retained) {
+      t = p->data.and.xs[0];
+      free(p->data.and.xs); free(p->data.and.dxs);
+      mpc_optimise_replace(p, t);
+      continue;
+    }
+
     return;
 
   }
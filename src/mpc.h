@@ -270,7 +270,8 @@ enum {
   MPC_RE_M         = 1,
   MPC_RE_S         = 2,
   MPC_RE_MULTILINE = 1,
-  MPC_RE_DOTALL    = 2
+  MPC_RE_DOTALL    = 2,
+  MPC_RE_NO_OPTIMISE = 4
 };
 
 mpc_parser_t *mpc_re(const char *re);
@@ -353,7 +354,8 @@ mpc_parser_t *mpca_and(int n, ...);
 enum {
   MPCA_LANG_DEFAULT              = 0,
   MPCA_LANG_PREDICTIVE           = 1,
-  MPCA_LANG_WHITESPACE_SENSITIVE = 2
+  MPCA_LANG_WHITESPACE_SENSITIVE = 2,
+  MPCA_LANG_NO_OPTIMISE          = 4
 };
 
 mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...);
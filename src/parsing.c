@@ -7,18 +7,16 @@
 #include <editline/readline.h>
 
 // Parser Combinator Library
+#include "batch.h"
 #include "eval.h"
+#include "grammar.h"
 #include "lib.h"
+#include "memstats.h"
 #include "mpc.h"
+#include "profile.h"
+#include "server.h"
 
-// Forward declare parsers
-mpc_parser_t *Number;
-mpc_parser_t *Symbol;
-mpc_parser_t *String;
-mpc_parser_t *Comment;
-mpc_parser_t *Sexpr;
-mpc_parser_t *Qexpr;
-mpc_parser_t *Expr;
+// Top-level parser, needed by builtin_load
 mpc_parser_t *Lispy;
 
 void run_prompt(lenv *e, mpc_parser_t *parser);
@@ -26,54 +24,82 @@ void run_interpreter(lenv *e, int argc, char **argv);
 
 int main(int argc, char **argv)
 {
-    // Defining the Grammar for Lisp-in-C
-    Number = mpc_new("number");
-    Symbol = mpc_new("symbol");
-    String = mpc_new("string");
-    Comment = mpc_new("comment");
-    Sexpr = mpc_new("sexpr");
-    Qexpr = mpc_new("qexpr");
-    Expr = mpc_new("expr");
-    Lispy = mpc_new("lispy");
-
-    mpca_lang(MPCA_LANG_DEFAULT, "                                            \
-        number   : /-?[0-9]+[.]?[0-9]*/;                                \
-        symbol   : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&^%|]+/;                 \
-        string   : /\"(\\\\.|[^\"])*\"/;                                \
-        comment  : /;[^\\r\\n]*/;                                       \
-        sexpr    : '(' <expr>* ')';                                     \
-        qexpr    : '{' <expr>* '}';                                     \
-        expr     : <number> | <symbol> |  <string> | <sexpr> | <qexpr>; \
-        lispy    : /^/ <expr>* /$/;                                     \
-    ",
-              Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy);
-
     // Create environment for variables and functions
     // Register builtin functions
     lenv *env = lenv_new();
     lenv_add_builtins(env);
 
-    if (argc <= 1)
+    // Leading options, every remaining argument is a file to load
+    char *serve = NULL;
+    char *profile = NULL;
+    bool batch = false;
+    bool mem_stats = false;
+    bool grammar_stats = false;
+    int first = 1;
+    for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++)
+    {
+        if (strncmp(argv[first], "--serve=", 8) == 0)
+            serve = argv[first] + 8;
+        else if (strcmp(argv[first], "--batch") == 0)
+            batch = true;
+        else if (strncmp(argv[first], "--profile=", 10) == 0)
+            profile = argv[first] + 10;
+        else if (strcmp(argv[first], "--mem-stats") == 0)
+            mem_stats = true;
+        else if (strcmp(argv[first], "--grammar-stats") == 0)
+            grammar_stats = true;
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[first]);
+            return 1;
+        }
+    }
+
+    Lispy = lispy_grammar_new(grammar_stats);
+
+    if (profile && prof_start(profile))
+        return 1;
+    mem_track_sites(mem_stats);
+
+    int status = 0;
+    if (serve)
+    {
+        // Files are loaded once as a prelude shared by every connection
+        run_interpreter(env, argc - first, argv + first);
+        status = run_server(env, Lispy, serve);
+    }
+    else if (batch)
+    {
+        status = run_batch(env, Lispy, argc - first, argv + first);
+    }
+    else if (first >= argc)
     {
         run_prompt(env, Lispy);
     }
     else
     {
-        run_interpreter(env, argc, argv);
+        run_interpreter(env, argc - first, argv + first);
     }
 
+    prof_stop();
     lenv_del(env);
-    mpc_cleanup(8, Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy);
 
-    return 0;
+    // Dumped after teardown so live counts show what leaked
+    if (mem_stats)
+    {
+        lbuf *b = lbuf_new(stderr);
+        mem_report(b);
+        lbuf_flush(b);
+        lbuf_del(b);
+    }
+    lispy_grammar_delete();
+
+    return status;
 }
 
 // ! Requires Lispy parser
 lval *builtin_load(lenv *e, lval *v)
 {
-    LASSERT_NUMARGS("load", v, 1);
-    LASSERT_TYPE("load", v, 0, LVAL_STR);
-
     // Parse file given by arg
     mpc_result_t r;
     if (mpc_parse_contents(v->cell[0]->str, Lispy, &r))
@@ -160,8 +186,8 @@ void run_prompt(lenv *e, mpc_parser_t *parser)
 
 void run_interpreter(lenv *e, int argc, char **argv)
 {
-    // Loop through each main argument, filenames given
-    for (size_t i = 1; i < argc; i++)
+    // Loop through each filename given
+    for (size_t i = 0; i < argc; i++)
     {
         // Build a lval with all the file's expressions
         lval *args = lval_add(lval_sexpr(), lval_str(argv[i]));
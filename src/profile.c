@@ -0,0 +1,176 @@
+// sigaction and setitimer are XSI, hidden by -std=c99
+#define _XOPEN_SOURCE 700
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "buffer.h"
+#include "profile.h"
+
+// Sampling period in microseconds
+#define PROF_INTERVAL 1000
+
+const char *volatile prof_stack[PROF_STACK_MAX];
+volatile int prof_depth = 0;
+volatile size_t prof_used = 0;
+
+/* Samples waiting to be folded
+Each is the names of its frames, outermost first, followed by NULL */
+static const char *volatile prof_pool[PROF_POOL];
+static volatile unsigned long prof_dropped = 0;
+
+// Distinct folded stacks and how often each was sampled
+typedef struct
+{
+    char *stack;
+    unsigned long count;
+} prof_entry;
+
+static prof_entry *prof_table = NULL;
+static size_t prof_table_cap = 0;
+static size_t prof_table_count = 0;
+
+static FILE *prof_out = NULL;
+
+static void prof_sample(int sig)
+{
+    int depth = prof_depth < PROF_STACK_MAX ? prof_depth : PROF_STACK_MAX;
+    if (prof_used + depth + 1 > PROF_POOL)
+    {
+        prof_dropped++;
+        return;
+    }
+
+    size_t used = prof_used;
+    for (size_t i = 0; i < depth; i++)
+        prof_pool[used++] = prof_stack[i];
+    prof_pool[used++] = NULL;
+    prof_used = used;
+}
+
+static unsigned long prof_hash(const char *s)
+{
+    // FNV-1a
+    unsigned long h = 2166136261u;
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+static void prof_count(char *stack)
+{
+    // Keep the table at most half full
+    if (prof_table_count * 2 >= prof_table_cap)
+    {
+        size_t cap = prof_table_cap ? prof_table_cap * 2 : 1024;
+        prof_entry *table = calloc(cap, sizeof(prof_entry));
+        for (size_t i = 0; i < prof_table_cap; i++)
+        {
+            if (!prof_table[i].stack)
+                continue;
+            size_t j = prof_hash(prof_table[i].stack) & (cap - 1);
+            while (table[j].stack)
+                j = (j + 1) & (cap - 1);
+            table[j] = prof_table[i];
+        }
+        free(prof_table);
+        prof_table = table;
+        prof_table_cap = cap;
+    }
+
+    size_t i = prof_hash(stack) & (prof_table_cap - 1);
+    while (prof_table[i].stack && strcmp(prof_table[i].stack, stack) != 0)
+        i = (i + 1) & (prof_table_cap - 1);
+
+    if (prof_table[i].stack)
+    {
+        prof_table[i].count++;
+        free(stack);
+        return;
+    }
+
+    prof_table[i].stack = stack;
+    prof_table[i].count = 1;
+    prof_table_count++;
+}
+
+void prof_drain(void)
+{
+    // The handler must not append while the pool is being read
+    sigset_t set, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    sigprocmask(SIG_BLOCK, &set, &old);
+
+    lbuf *b = lbuf_new(NULL);
+    lbuf_puts(b, PROF_ROOT);
+    for (size_t i = 0; i < prof_used; i++)
+    {
+        if (prof_pool[i])
+        {
+            lbuf_putc(b, ';');
+            lbuf_puts(b, prof_pool[i]);
+            continue;
+        }
+
+        prof_count(lbuf_take(b));
+        lbuf_puts(b, PROF_ROOT);
+    }
+    lbuf_del(b);
+    prof_used = 0;
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+int prof_start(const char *path)
+{
+    prof_out = fopen(path, "w");
+    if (!prof_out)
+    {
+        perror(path);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = prof_sample;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &sa, NULL);
+
+    struct itimerval timer = {{0, PROF_INTERVAL}, {0, PROF_INTERVAL}};
+    setitimer(ITIMER_PROF, &timer, NULL);
+
+    return 0;
+}
+
+void prof_stop(void)
+{
+    if (!prof_out)
+        return;
+
+    struct itimerval timer = {{0, 0}, {0, 0}};
+    setitimer(ITIMER_PROF, &timer, NULL);
+    signal(SIGPROF, SIG_IGN);
+
+    prof_drain();
+    for (size_t i = 0; i < prof_table_cap; i++)
+    {
+        if (!prof_table[i].stack)
+            continue;
+        fprintf(prof_out, "%s %lu\n", prof_table[i].stack,
+                prof_table[i].count);
+        free(prof_table[i].stack);
+    }
+    free(prof_table);
+    prof_table = NULL;
+    prof_table_cap = prof_table_count = 0;
+
+    if (prof_dropped)
+        fprintf(stderr, "profile: dropped %lu samples\n", prof_dropped);
+
+    fclose(prof_out);
+    prof_out = NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef profile_h
+#define profile_h
+
+#include <stddef.h>
+
+// Deepest call stack recorded, deeper frames are counted but not named
+#define PROF_STACK_MAX 256
+
+// Outermost frame of every stack, so top-level work is visible too
+#define PROF_ROOT "lispy"
+
+// Frame names buffered between signals before being folded
+#define PROF_POOL (1 << 20)
+
+/* Shadow call stack maintained by lval_call, and by eval for builtins it calls
+Entries are written before the depth grows so the sampler never sees junk */
+extern const char *volatile prof_stack[PROF_STACK_MAX];
+extern volatile int prof_depth;
+extern volatile size_t prof_used;
+
+/* Fold buffered samples into the stack counts */
+void prof_drain(void);
+
+static inline void prof_push(const char *name)
+{
+    if (prof_depth < PROF_STACK_MAX)
+        prof_stack[prof_depth] = name;
+    prof_depth++;
+
+    // Folding happens here, outside of the signal handler
+    if (prof_used > PROF_POOL / 2)
+        prof_drain();
+}
+
+static inline void prof_pop(void)
+{
+    prof_depth--;
+}
+
+/* Sample the shadow call stack on every SIGPROF tick
+Returns non-zero if PATH cannot be written */
+int prof_start(const char *path);
+
+/* Stop sampling and write folded stacks to the path given to prof_start
+One line per distinct stack: "lispy;outer;inner count" */
+void prof_stop(void);
+
+#endif
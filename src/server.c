@@ -0,0 +1,326 @@
+// sigaction is POSIX, hidden by -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+
+#define SERVE_MAX_EVENTS 64
+
+typedef struct conn conn;
+
+struct conn
+{
+    int fd;
+    // Child of the global environment, private to this connection
+    lenv *env;
+
+    // Bytes received but not yet consumed as a whole request
+    lbuf *in;
+
+    // Responses not yet accepted by the socket, sent from OUT_POS
+    lbuf *out;
+    size_t out_pos;
+    // Whether epoll is also watching for writability
+    bool writing;
+
+    // Open connections, kept to release them on shutdown
+    conn *prev;
+    conn *next;
+};
+
+static volatile sig_atomic_t serving = 1;
+
+static void server_stop(int sig)
+{
+    serving = 0;
+}
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static conn *conn_new(int fd, lenv *global)
+{
+    conn *c = calloc(1, sizeof(conn));
+    c->fd = fd;
+    c->in = lbuf_new(NULL);
+    c->out = lbuf_new(NULL);
+
+    // Definitions made by this connection stop at its own environment
+    c->env = lenv_new();
+    c->env->parent = global;
+    c->env->root = true;
+
+    return c;
+}
+
+static void conn_del(conn *c)
+{
+    // Closing the descriptor also removes it from the epoll set
+    close(c->fd);
+    lenv_del(c->env);
+    lbuf_del(c->in);
+    lbuf_del(c->out);
+    free(c);
+}
+
+/* Evaluate one request, everything printed becomes the response */
+static void conn_eval(conn *c, mpc_parser_t *parser, const char *src,
+                      size_t len)
+{
+    // Output is printed straight behind a placeholder frame header
+    lbuf *out = c->out;
+    size_t frame = out->len;
+    lbuf_write(out, "\0\0\0\0", 5);
+
+    lbuf *prev = lval_get_output();
+    lval_set_output(out);
+
+    char status = SERVE_OK;
+    mpc_result_t r;
+    if (mpc_nparse("<socket>", src, len, parser, &r))
+    {
+        lval *expr = lval_read(r.output);
+        mpc_ast_delete(r.output);
+
+        // Evaluate each expression, answer with the last value
+        lval *x = lval_sexpr();
+        while (expr->count)
+        {
+            lval_del(x);
+            x = lval_eval(c->env, lval_pop(expr, 0));
+            if (x->type == LVAL_ERR)
+            {
+                status = SERVE_ERR;
+                break;
+            }
+        }
+        lval_println(c->env, x);
+
+        lval_del(x);
+        lval_del(expr);
+    }
+    else
+    {
+        char *err_msg = mpc_err_string(r.error);
+        mpc_err_delete(r.error);
+        lbuf_puts(out, err_msg);
+        free(err_msg);
+        status = SERVE_ERR;
+    }
+
+    lval_set_output(prev);
+
+    uint32_t n = htonl((uint32_t)(out->len - frame - 4));
+    memcpy(out->data + frame, &n, 4);
+    out->data[frame + 4] = status;
+}
+
+/* Drain the socket into the input buffer
+Returns 0 once the peer has closed or failed */
+static int conn_read(conn *c)
+{
+    while (1)
+    {
+        lbuf_reserve(c->in, 4096);
+        ssize_t n = read(c->fd, c->in->data + c->in->len,
+                         c->in->cap - c->in->len);
+
+        if (n > 0)
+            c->in->len += n;
+        else if (n == 0)
+            return 0;
+        else if (errno != EINTR)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+/* Evaluate every complete request in the input buffer
+Returns 0 if the peer announced an oversized frame */
+static int conn_process(conn *c, mpc_parser_t *parser)
+{
+    lbuf *in = c->in;
+    size_t pos = 0;
+    while (in->len - pos >= 4)
+    {
+        uint32_t n;
+        memcpy(&n, in->data + pos, 4);
+        n = ntohl(n);
+
+        if (n > SERVE_MAX_FRAME)
+            return 0;
+        if (in->len - pos - 4 < n)
+            break;
+
+        conn_eval(c, parser, in->data + pos + 4, n);
+        pos += 4 + n;
+    }
+
+    // Keep the partial frame at the front of the buffer
+    if (pos)
+        memmove(in->data, in->data + pos, in->len - pos);
+    in->len -= pos;
+
+    return 1;
+}
+
+/* Write as much of the pending responses as the socket takes
+Returns 0 if the peer is gone */
+static int conn_flush(conn *c)
+{
+    while (c->out_pos < c->out->len)
+    {
+        ssize_t n = send(c->fd, c->out->data + c->out_pos,
+                         c->out->len - c->out_pos, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->out_pos += n;
+    }
+
+    c->out_pos = c->out->len = 0;
+    return 1;
+}
+
+static int server_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path too long -- %s\n", path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    // Replace a stale socket left by a previous server
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0 || set_nonblocking(fd) < 0)
+    {
+        perror("serve");
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int run_server(lenv *e, mpc_parser_t *parser, const char *path)
+{
+    int lfd = server_listen(path);
+    if (lfd < 0)
+        return 1;
+
+    // The listening socket is the only event without a connection
+    int ep = epoll_create1(0);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &ev);
+
+    // No SA_RESTART, so epoll_wait returns when asked to stop
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = server_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("Serving on %s\n", path);
+    fflush(stdout);
+
+    conn *conns = NULL;
+    struct epoll_event events[SERVE_MAX_EVENTS];
+    while (serving)
+    {
+        int n = epoll_wait(ep, events, SERVE_MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            conn *c = events[i].data.ptr;
+
+            // Accept every pending connection
+            if (c == NULL)
+            {
+                int fd;
+                while ((fd = accept(lfd, NULL, NULL)) >= 0)
+                {
+                    set_nonblocking(fd);
+                    c = conn_new(fd, e);
+
+                    c->next = conns;
+                    if (conns)
+                        conns->prev = c;
+                    conns = c;
+
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = c;
+                    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+                }
+                continue;
+            }
+
+            // A peer that closed still gets answers to what it sent
+            int open = conn_read(c);
+            int alive = conn_process(c, parser) && conn_flush(c) && open;
+
+            if (!alive)
+            {
+                if (c->prev)
+                    c->prev->next = c->next;
+                else
+                    conns = c->next;
+                if (c->next)
+                    c->next->prev = c->prev;
+                conn_del(c);
+                continue;
+            }
+
+            // Only wake up on writability while responses are pending
+            bool writing = c->out->len > 0;
+            if (writing != c->writing)
+            {
+                ev.events = EPOLLIN | (writing ? EPOLLOUT : 0);
+                ev.data.ptr = c;
+                epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+                c->writing = writing;
+            }
+        }
+    }
+
+    while (conns)
+    {
+        conn *next = conns->next;
+        conn_del(conns);
+        conns = next;
+    }
+    close(ep);
+    close(lfd);
+    unlink(path);
+
+    return 0;
+}
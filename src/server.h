@@ -0,0 +1,25 @@
+#ifndef server_h
+#define server_h
+
+#include "eval.h"
+#include "mpc.h"
+
+/* Frames exchanged over the socket
+Request  -> [4 byte big-endian length] [Lispy source]
+Response -> [4 byte big-endian length] [status byte] [printed output]
+Status is SERVE_OK, or SERVE_ERR when parsing or evaluation failed */
+enum
+{
+    SERVE_OK,
+    SERVE_ERR,
+};
+
+// Largest request accepted before the connection is dropped
+#define SERVE_MAX_FRAME (16 * 1024 * 1024)
+
+/* Answer eval requests for PARSER on a Unix domain socket at PATH
+Each connection evaluates inside its own child environment of E
+Runs until SIGINT or SIGTERM, returns non-zero if setup failed */
+int run_server(lenv *e, mpc_parser_t *parser, const char *path);
+
+#endif
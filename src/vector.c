@@ -0,0 +1,316 @@
+#include "vector.h"
+#include "memstats.h"
+
+static lvec *lvec_node(int height)
+{
+    lvec *n = malloc(sizeof(lvec));
+    mem_shared(LVAL_QEXPR, sizeof(lvec));
+    n->refs = 1;
+    n->height = height;
+    n->count = 0;
+    n->size = 0;
+    n->hashed = false;
+
+    return n;
+}
+
+// Append X to leaf N, taking ownership of it
+static void lvec_push_val(lvec *n, lval *x)
+{
+    n->slot.vals[n->count++] = x;
+    n->size++;
+}
+
+// Append K to inner node N, taking the reference
+static void lvec_push_kid(lvec *n, lvec *k)
+{
+    n->slot.kids[n->count++] = k;
+    n->size += k->size;
+}
+
+/* Stack parents over the N NODES of one height until a single root is left
+The array is reused for each level, every reference is moved to the root */
+static lvec *lvec_build(lvec **nodes, size_t n)
+{
+    while (n > 1)
+    {
+        size_t parents = 0;
+        for (size_t i = 0; i < n; i += LVEC_WIDTH)
+        {
+            lvec *p = lvec_node(nodes[i]->height + 1);
+            for (size_t j = i; j < n && j < i + LVEC_WIDTH; j++)
+                lvec_push_kid(p, nodes[j]);
+            nodes[parents++] = p;
+        }
+        n = parents;
+    }
+
+    return nodes[0];
+}
+
+lvec *lvec_new(lval **cells, size_t n)
+{
+    size_t leaves = (n + LVEC_WIDTH - 1) / LVEC_WIDTH;
+    lvec **nodes = malloc(sizeof(lvec *) * leaves);
+
+    for (size_t i = 0; i < leaves; i++)
+    {
+        nodes[i] = lvec_node(0);
+        for (size_t j = i * LVEC_WIDTH; j < n && j < (i + 1) * LVEC_WIDTH; j++)
+            lvec_push_val(nodes[i], cells[j]);
+    }
+
+    lvec *v = lvec_build(nodes, leaves);
+    free(nodes);
+
+    return v;
+}
+
+lvec *lvec_ref(lvec *v)
+{
+    v->refs++;
+    return v;
+}
+
+void lvec_del(lvec *v)
+{
+    if (!v || --v->refs)
+        return;
+
+    for (size_t i = 0; i < v->count; i++)
+    {
+        if (v->height)
+            lvec_del(v->slot.kids[i]);
+        else
+            lval_del(v->slot.vals[i]);
+    }
+    free(v);
+}
+
+lval *lvec_get(lvec *v, size_t i)
+{
+    // Skip over whole children, they may not all be full
+    while (v->height)
+    {
+        size_t k = 0;
+        while (i >= v->slot.kids[k]->size)
+            i -= v->slot.kids[k++]->size;
+        v = v->slot.kids[k];
+    }
+
+    return v->slot.vals[i];
+}
+
+/* Height a vector of SIZE elements has when every node is full */
+static int lvec_depth(size_t size)
+{
+    int depth = 0;
+    for (size_t cap = LVEC_WIDTH; cap < size; cap *= LVEC_WIDTH)
+        depth++;
+
+    return depth;
+}
+
+// Collect a reference to every leaf below V, in order
+static void lvec_leaves(lvec *v, lvec **leaves, size_t *n)
+{
+    if (!v->height)
+    {
+        leaves[(*n)++] = lvec_ref(v);
+        return;
+    }
+    for (size_t i = 0; i < v->count; i++)
+        lvec_leaves(v->slot.kids[i], leaves, n);
+}
+
+/* Slices and joins can leave nodes partly filled and grow V taller than its
+size needs, past a margin the leaves are restacked under full inner nodes.
+Takes the reference to V and returns the balanced vector */
+static lvec *lvec_balance(lvec *v)
+{
+    // A lone child replaces its parent
+    while (v->height && v->count == 1)
+    {
+        lvec *k = lvec_ref(v->slot.kids[0]);
+        lvec_del(v);
+        v = k;
+    }
+
+    if (v->height <= lvec_depth(v->size) + 2)
+        return v;
+
+    lvec **leaves = malloc(sizeof(lvec *) * v->size);
+    size_t n = 0;
+    lvec_leaves(v, leaves, &n);
+    lvec_del(v);
+    v = lvec_build(leaves, n);
+    free(leaves);
+
+    return v;
+}
+
+// Elements START to END of V, both within V and not empty
+static lvec *lvec_cut(lvec *v, size_t start, size_t end)
+{
+    if (start == 0 && end == v->size)
+        return lvec_ref(v);
+
+    lvec *n = lvec_node(v->height);
+
+    // Leaves own their elements, kept ones are copied
+    if (!v->height)
+    {
+        for (size_t i = start; i < end; i++)
+            lvec_push_val(n, lval_copy(v->slot.vals[i]));
+        return n;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < v->count && offset < end; i++)
+    {
+        lvec *k = v->slot.kids[i];
+        if (offset + k->size > start)
+        {
+            size_t from = start > offset ? start - offset : 0;
+            size_t to = end < offset + k->size ? end - offset : k->size;
+            lvec_push_kid(n, lvec_cut(k, from, to));
+        }
+        offset += k->size;
+    }
+
+    return n;
+}
+
+lvec *lvec_slice(lvec *v, size_t start, size_t end)
+{
+    if (start >= end)
+        return NULL;
+
+    return lvec_balance(lvec_cut(v, start, end));
+}
+
+/* A and B side by side, both of the same height
+One node when their slots fit together, a parent of both otherwise */
+static lvec *lvec_join_level(lvec *a, lvec *b)
+{
+    lvec *n;
+    if (a->count + b->count > LVEC_WIDTH)
+    {
+        n = lvec_node(a->height + 1);
+        lvec_push_kid(n, lvec_ref(a));
+        lvec_push_kid(n, lvec_ref(b));
+        return n;
+    }
+
+    n = lvec_node(a->height);
+    lvec *sides[] = {a, b};
+    for (size_t s = 0; s < 2; s++)
+        for (size_t i = 0; i < sides[s]->count; i++)
+        {
+            if (n->height)
+                lvec_push_kid(n, lvec_ref(sides[s]->slot.kids[i]));
+            else
+                lvec_push_val(n, lval_copy(sides[s]->slot.vals[i]));
+        }
+
+    return n;
+}
+
+/* A followed by B, as tall as the taller of them or one level more
+The shorter one is joined along the facing edge of the taller */
+static lvec *lvec_join(lvec *a, lvec *b)
+{
+    if (a->height == b->height)
+        return lvec_join_level(a, b);
+
+    lvec *n, *r, *joined;
+    if (a->height > b->height)
+    {
+        r = lvec_join(a->slot.kids[a->count - 1], b);
+        n = lvec_node(a->height);
+        for (size_t i = 0; i < a->count - 1; i++)
+            lvec_push_kid(n, lvec_ref(a->slot.kids[i]));
+
+        if (r->height < n->height)
+        {
+            lvec_push_kid(n, r);
+            return n;
+        }
+        joined = lvec_join_level(n, r);
+    }
+    else
+    {
+        r = lvec_join(a, b->slot.kids[0]);
+        n = lvec_node(b->height);
+
+        bool inside = r->height < n->height;
+        if (inside)
+            lvec_push_kid(n, r);
+        for (size_t i = 1; i < b->count; i++)
+            lvec_push_kid(n, lvec_ref(b->slot.kids[i]));
+
+        if (inside)
+            return n;
+        joined = lvec_join_level(r, n);
+    }
+
+    // The join took its own references to both halves
+    lvec_del(n);
+    lvec_del(r);
+
+    return joined;
+}
+
+lvec *lvec_concat(lvec *a, lvec *b)
+{
+    if (!a || !b)
+        return a ? lvec_ref(a) : b ? lvec_ref(b) : NULL;
+
+    return lvec_balance(lvec_join(a, b));
+}
+
+static void lvec_copy_from(lvec *v, lval **cells, size_t *n)
+{
+    for (size_t i = 0; i < v->count; i++)
+    {
+        if (v->height)
+            lvec_copy_from(v->slot.kids[i], cells, n);
+        else
+            cells[(*n)++] = lval_copy(v->slot.vals[i]);
+    }
+}
+
+void lvec_copy_to(lvec *v, lval **cells)
+{
+    size_t n = 0;
+    lvec_copy_from(v, cells, &n);
+}
+
+unsigned long lvec_hash(lvec *v)
+{
+    if (v->hashed)
+        return v->hash;
+
+    // Each part is weighted by the scale of everything before it
+    unsigned long hash = 0, scale = 1;
+    for (size_t i = 0; i < v->count; i++)
+    {
+        if (v->height)
+        {
+            lvec *k = v->slot.kids[i];
+            hash += lvec_hash(k) * scale;
+            scale *= k->scale;
+        }
+        else
+        {
+            hash += lval_hash(v->slot.vals[i]) * scale;
+            scale *= LHASH_FACTOR;
+        }
+    }
+
+    v->hash = hash;
+    v->scale = scale;
+    v->hashed = true;
+
+    return hash;
+}
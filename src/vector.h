@@ -0,0 +1,67 @@
+#ifndef vector_h
+#define vector_h
+
+#include "eval.h"
+
+// Slots per node, elements in a leaf or children of an inner node
+#define LVEC_WIDTH 32
+
+// Q-Expressions from this length up are kept as vectors once shared
+#define LVEC_MIN 64
+
+/* Node of a persistent vector, shared between lists by reference count
+A radix tree of LVEC_WIDTH slots per node, elements in the leaves. Nodes are
+never changed once built. A slice copies only the nodes along its two cut
+edges, a concatenation those along the edge where the halves meet, every
+other subtree is shared. Inner nodes may hold fewer than LVEC_WIDTH children,
+so sizes are kept to find an index without assuming full subtrees */
+struct lvec
+{
+    int refs;
+    // 0 for leaves
+    int height;
+    // Slots in use
+    int count;
+    // Elements below this node
+    size_t size;
+    /* List hash of the elements below and LHASH_FACTOR to the power SIZE
+    Filled by lvec_hash on first use */
+    bool hashed;
+    unsigned long hash;
+    unsigned long scale;
+    union
+    {
+        lval *vals[LVEC_WIDTH];
+        lvec *kids[LVEC_WIDTH];
+    } slot;
+};
+
+/* Vector of the N lvals in CELLS, taking ownership of them
+N has to be positive */
+lvec *lvec_new(lval **cells, size_t n);
+
+/* Share V with one more owner */
+lvec *lvec_ref(lvec *v);
+
+/* Drop a reference, the last one frees V and its elements
+Does nothing on NULL */
+void lvec_del(lvec *v);
+
+/* Element I of V, still owned by V */
+lval *lvec_get(lvec *v, size_t i);
+
+/* Elements START to END, excluded, of V as a new vector
+NULL when the range is empty */
+lvec *lvec_slice(lvec *v, size_t start, size_t end);
+
+/* Elements of A followed by those of B as a new vector
+Either may be NULL for an empty vector */
+lvec *lvec_concat(lvec *a, lvec *b);
+
+/* Store copies of every element of V in CELLS */
+void lvec_copy_to(lvec *v, lval **cells);
+
+/* List hash of the elements of V, see LHASH_FACTOR */
+unsigned long lvec_hash(lvec *v);
+
+#endif